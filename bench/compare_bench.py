@@ -0,0 +1,80 @@
+import json
+import sys
+
+# ==============================================================================
+# Compares two cf_pipeline_bench --json result files and exits with 1 if the
+# candidate regressed against the baseline by more than TOLERANCE on any metric.
+#
+#   python bench/compare_bench.py baseline.json candidate.json [tolerance]
+# ==============================================================================
+TOLERANCE = 0.15   # 15%: loopback timing on a shared machine is noisy
+
+# metric path, True if higher is better
+METRICS = [
+    (("events_per_sec",), True),
+    (("producer_ns_per_event",), False),
+    (("latency_ns", "p50"), False),
+    (("latency_ns", "p99"), False),
+    (("latency_ns", "p999"), False),
+    (("drop_rate",), False),
+]
+
+# Latencies below this many ns are scheduler noise; don't flag them
+LATENCY_FLOOR_NS = 20000
+# Drop rate changes below this are noise as well
+DROP_RATE_FLOOR = 0.001
+
+
+def load(path: str) -> dict:
+    with open(path, "r", encoding="utf-8") as f:
+        doc = json.load(f)
+    return {(r["shape"], r["protocol"]): r for r in doc["results"]}
+
+
+def metric(result: dict, path) -> float:
+    value = result
+    for key in path:
+        value = value[key]
+    return float(value)
+
+
+def regressed(name: str, base: float, cand: float, higher_is_better: bool, tolerance: float) -> bool:
+    if name.startswith("latency_ns") and max(base, cand) < LATENCY_FLOOR_NS:
+        return False
+    if name == "drop_rate":
+        return cand - base > max(DROP_RATE_FLOOR, base * tolerance)
+    if base <= 0:
+        return False
+    change = (cand - base) / base
+    return change < -tolerance if higher_is_better else change > tolerance
+
+
+def main():
+    if len(sys.argv) not in (3, 4):
+        print("usage: compare_bench.py baseline.json candidate.json [tolerance]")
+        return 2
+    tolerance = float(sys.argv[3]) if len(sys.argv) == 4 else TOLERANCE
+    baseline = load(sys.argv[1])
+    candidate = load(sys.argv[2])
+
+    failures = 0
+    for key in sorted(baseline):
+        if key not in candidate:
+            print(f"{key[0]} v{key[1]}: missing from candidate")
+            continue
+        for path, higher_is_better in METRICS:
+            name = ".".join(path)
+            base = metric(baseline[key], path)
+            cand = metric(candidate[key], path)
+            bad = regressed(name, base, cand, higher_is_better, tolerance)
+            failures += bad
+            change = (cand - base) / base * 100 if base else 0.0
+            print(f"{'REGRESSED' if bad else 'ok':9} {key[0]:18} v{key[1]} {name:22} "
+                  f"{base:14.1f} -> {cand:14.1f} ({change:+.1f}%)")
+
+    print(f"\n{failures} regression(s) at {tolerance:.0%} tolerance")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,180 @@
+// load_shapes.cpp
+#include "load_shapes.h"
+
+#include <cstdio>
+#include <cstring>
+
+const char* const g_loadShapeNames[] = { "chat_storm", "status_dump", "precache_flood", "stufftext_scripts" };
+const int g_loadShapeCount = sizeof(g_loadShapeNames) / sizeof(g_loadShapeNames[0]);
+
+static const char* const kWords[] = {
+    "gg", "wp", "lol", "push", "left", "right", "medic", "need", "ammo", "here", "follow",
+    "me", "wait", "go", "boss", "incoming", "the", "door", "is", "locked", "anyone", "got",
+    "key", "revive", "please", "thanks", "nice", "shot", "map", "vote", "next", "rtv",
+};
+static const int kPlayers = 32;
+
+std::string LoadShape::words(int minWords, int maxWords) {
+    std::string text;
+    int count = range(minWords, maxWords);
+    for (int i = 0; i < count; i++) {
+        if (i) text += ' ';
+        text += kWords[range(0, (int)(sizeof(kWords) / sizeof(kWords[0])) - 1)];
+    }
+    return text;
+}
+
+static std::string Marker(uint32_t seq) {
+    char marker[16];
+    snprintf(marker, sizeof(marker), "~%u ", seq);
+    return marker;
+}
+
+// [first byte][format\0][arg\0]..., as the engine hands user messages to the hook
+static std::vector<char> UserMessage(int firstByte, const std::vector<std::string>& strings) {
+    std::vector<char> msg(1, (char)firstByte);
+    for (const std::string& str : strings) {
+        msg.insert(msg.end(), str.begin(), str.end());
+        msg.push_back('\0');
+    }
+    return msg;
+}
+
+static std::vector<char> CString(const std::string& text) {
+    return std::vector<char>(text.c_str(), text.c_str() + text.size() + 1);
+}
+
+static HookCall Call(HookCall::Kind kind, std::vector<char> payload, uint32_t firstSeq, uint32_t events = 1) {
+    return HookCall{ kind, std::move(payload), firstSeq, events };
+}
+
+static std::string PlayerName(int index) {
+    char name[32];
+    snprintf(name, sizeof(name), "Player%02d", index + 1);
+    return name;
+}
+
+class ChatStorm : public LoadShape {
+public:
+    using LoadShape::LoadShape;
+    const char* name() const override { return "chat_storm"; }
+
+    void nextBurst(uint32_t& seq, std::vector<HookCall>& out) override {
+        for (int player = 0; player < kPlayers; player++) {
+            // "\x02" colors the name like the engine's own SayText
+            std::string format = "\x02%s: %s";
+            out.push_back(Call(HookCall::SAY_TEXT, UserMessage(player + 1,
+                { format, PlayerName(player), Marker(seq) + words(1, 24) }), seq));
+            seq++;
+        }
+        if (range(0, 7) == 0) {
+            const char* format = range(0, 1) ? "%s has joined the game" : "%s has left the game";
+            out.push_back(Call(HookCall::TEXT_MSG, UserMessage(2,
+                { format, Marker(seq) + PlayerName(range(0, kPlayers - 1)) }), seq));
+            seq++;
+        }
+    }
+};
+
+class StatusDump : public LoadShape {
+public:
+    using LoadShape::LoadShape;
+    const char* name() const override { return "status_dump"; }
+
+    void nextBurst(uint32_t& seq, std::vector<HookCall>& out) override {
+        static const char* const header[] = {
+            "hostname:  Sven Co-op Dedicated Server\n",
+            "version :  48/0.0.0.0 8684 secure\n",
+            "tcp/ip  :  203.0.113.7:27015\n",
+            "map     :  svencoop1 at: 0 x, 0 y, 0 z\n",
+            "players :  32 active (32 max)\n",
+            "\n",
+            "#      name userid uniqueid frag time ping loss adr\n",
+        };
+        for (const char* line : header) {
+            out.push_back(Call(HookCall::PRINT, CString(Marker(seq) + line), seq));
+            seq++;
+        }
+        for (int player = 0; player < kPlayers; player++) {
+            char line[160];
+            snprintf(line, sizeof(line), "#%2d \"%s\" %d STEAM_0:%d:%d %d %02d:%02d %d %d\n",
+                player + 1, PlayerName(player).c_str(), range(1, 999), range(0, 1), range(10000, 99999999),
+                range(0, 150), range(0, 180), range(0, 59), range(5, 250), range(0, 3));
+            out.push_back(Call(HookCall::PRINT, CString(Marker(seq) + line), seq));
+            seq++;
+        }
+        out.push_back(Call(HookCall::PRINT, CString(Marker(seq) + "32 users\n"), seq));
+        seq++;
+    }
+};
+
+class PrecacheFlood : public LoadShape {
+public:
+    using LoadShape::LoadShape;
+    const char* name() const override { return "precache_flood"; }
+
+    void nextBurst(uint32_t& seq, std::vector<HookCall>& out) override {
+        static const char* const kinds[] = { "models", "sound", "sprites", "gfx/env" };
+        static const char* const extensions[] = { ".mdl", ".wav", ".spr", ".tga" };
+        // One OutputDebugString call carrying many lines, kept under the 4 KB safety flush
+        std::string chunk;
+        uint32_t first = seq;
+        int lines = range(32, 64);
+        for (int i = 0; i < lines; i++) {
+            int kind = range(0, 3);
+            chunk += Marker(seq++);
+            chunk += "Precaching ";
+            chunk += kinds[kind];
+            chunk += '/';
+            chunk += words(1, 2);
+            chunk += extensions[kind];
+            chunk += '\n';
+        }
+        out.push_back(Call(HookCall::DEBUG_STRING, CString(chunk), first, (uint32_t)lines));
+    }
+};
+
+class StuffTextScripts : public LoadShape {
+public:
+    using LoadShape::LoadShape;
+    const char* name() const override { return "stufftext_scripts"; }
+
+    void nextBurst(uint32_t& seq, std::vector<HookCall>& out) override {
+        std::string script = Marker(seq);
+        size_t length = (size_t)range(400, 2000);
+        while (script.size() < length) {
+            switch (range(0, 3)) {
+            case 0: script += "alias +cf_" + words(1, 1) + " \"" + words(2, 6) + "\"; "; break;
+            case 1: script += "bind " + words(1, 1) + " \"say " + words(2, 8) + "\"\n"; break;
+            case 2: script += "cl_" + words(1, 1) + " " + std::to_string(range(0, 100)) + "; "; break;
+            default: script += "echo " + words(3, 10) + "\n"; break;
+            }
+        }
+        out.push_back(Call(HookCall::STUFF_TEXT, CString(script), seq));
+        seq++;
+    }
+};
+
+std::unique_ptr<LoadShape> MakeChatStorm(uint32_t seed) {
+    return std::unique_ptr<LoadShape>(new ChatStorm(seed));
+}
+
+std::unique_ptr<LoadShape> MakeStatusDump(uint32_t seed) {
+    return std::unique_ptr<LoadShape>(new StatusDump(seed));
+}
+
+std::unique_ptr<LoadShape> MakePrecacheFlood(uint32_t seed) {
+    return std::unique_ptr<LoadShape>(new PrecacheFlood(seed));
+}
+
+std::unique_ptr<LoadShape> MakeStuffTextScripts(uint32_t seed) {
+    return std::unique_ptr<LoadShape>(new StuffTextScripts(seed));
+}
+
+std::unique_ptr<LoadShape> MakeLoadShape(const std::string& name, uint32_t seed) {
+    if (name == "chat_storm") return MakeChatStorm(seed);
+    if (name == "status_dump") return MakeStatusDump(seed);
+    if (name == "precache_flood") return MakePrecacheFlood(seed);
+    if (name == "stufftext_scripts") return MakeStuffTextScripts(seed);
+    return nullptr;
+}
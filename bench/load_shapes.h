@@ -0,0 +1,60 @@
+// load_shapes.h
+// Synthetic generators for the load shapes we see in real sessions. Each burst is a list
+// of hook invocations, built up front so the driver times only the hook itself. Every
+// event carries a "~<seq>" marker at the start of its content, which the receiver uses to
+// match datagrams to enqueue times; generated text never contains '~' otherwise.
+#ifndef CF_LOAD_SHAPES_H
+#define CF_LOAD_SHAPES_H
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+struct HookCall {
+    enum Kind {
+        SAY_TEXT,          // payload is a user message buffer
+        TEXT_MSG,          // payload is a user message buffer
+        PRINT,             // payload is a NUL-terminated string
+        STUFF_TEXT,
+        DEBUG_STRING
+    };
+
+    Kind kind;
+    std::vector<char> payload;
+    uint32_t firstSeq;
+    uint32_t events;       // events = consecutive seqs starting at firstSeq
+};
+
+class LoadShape {
+public:
+    explicit LoadShape(uint32_t seed) : rng_(seed) {}
+    virtual ~LoadShape() {}
+
+    virtual const char* name() const = 0;
+
+    // Appends the next burst to out, numbering its events from seq (advanced past them)
+    virtual void nextBurst(uint32_t& seq, std::vector<HookCall>& out) = 0;
+
+protected:
+    std::string words(int minWords, int maxWords);
+    int range(int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng_); }
+
+    std::mt19937 rng_;
+};
+
+// 32 players each saying one line per tick, with the odd join/leave TextMsg
+std::unique_ptr<LoadShape> MakeChatStorm(uint32_t seed);
+// `status` output: header plus one print per player line
+std::unique_ptr<LoadShape> MakeStatusDump(uint32_t seed);
+// Map-load precache spam: multi-kilobyte OutputDebugString chunks of many short lines
+std::unique_ptr<LoadShape> MakePrecacheFlood(uint32_t seed);
+// Long server-sent stufftext scripts (400-2000 bytes; past cf_frame_mtu they go out as fragments)
+std::unique_ptr<LoadShape> MakeStuffTextScripts(uint32_t seed);
+
+std::unique_ptr<LoadShape> MakeLoadShape(const std::string& name, uint32_t seed);
+extern const char* const g_loadShapeNames[];
+extern const int g_loadShapeCount;
+
+#endif // CF_LOAD_SHAPES_H
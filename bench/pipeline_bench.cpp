@@ -0,0 +1,475 @@
+// pipeline_bench.cpp
+// Throughput/latency benchmark of the full outbound path: synthetic load -> hooks
+// (CleanMessage, expansion, QueueTask) -> SendQueue -> ReactorWorkCallback -> loopback
+// receiver. Runs on the fake engine, so the numbers cover the core without MetaHook.
+//
+//   cf_pipeline_bench [--quick] [--events N] [--rate EVENTS_PER_SEC] [--protocol 1|2]
+//                     [--shape NAME] [--seed N] [--deferred] [--reliable] [--json PATH]
+//   cf_pipeline_bench --kernels [--quick] [--seed N]
+//
+// --rate 0 pushes as fast as the producer can, which measures overload behavior (drops)
+// rather than latency. --deferred runs with cf_deferred 1 (decoding on the sender),
+// --reliable with cf_reliable 1 (sequence numbers and the retransmit ring, no loss injected).
+// --json writes every result for compare_bench.py.
+// --kernels skips the pipeline and times each CleanMessage kernel on its own, in bytes per
+// TSC cycle, over several input lengths and control-byte densities.
+#include "tests/fake_engine.h"
+#include "load_shapes.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+struct BenchOptions {
+    std::vector<std::string> shapes;
+    std::vector<int> protocols = { 1, 2 };
+    uint32_t events = 100000;
+    double rate = 20000.0;
+    uint32_t seed = 1;
+    bool deferred = false;
+    bool reliable = false;
+    bool kernels = false;
+    bool quick = false;
+    std::string jsonPath;
+};
+
+struct BenchResult {
+    std::string shape;
+    int protocol = 1;
+    uint32_t events = 0;
+    uint32_t received = 0;
+    uint64_t queueDrops = 0;       // lane overflow or eviction
+    uint64_t sendDrops = 0;        // no route / sendto failure
+    double seconds = 0.0;
+    double eventsPerSec = 0.0;
+    double producerNsPerEvent = 0.0;
+    uint64_t datagrams = 0;
+    uint64_t datagramBytes = 0;
+    uint64_t p50 = 0, p99 = 0, p999 = 0, max = 0;   // enqueue -> receive, ns
+};
+
+static uint64_t TicksToNs(int64_t ticks) {
+    static const int64_t frequency = MonotonicFrequency();
+    if (ticks <= 0) return 0;
+    return (uint64_t)(ticks / frequency) * 1000000000ull +
+        (uint64_t)(ticks % frequency) * 1000000000ull / (uint64_t)frequency;
+}
+
+// Drains the loopback receiver on its own thread and stamps the arrival of each event
+class Receiver {
+public:
+    Receiver(FakeEngine& engine, std::vector<int64_t>& arrivals) : engine_(engine), arrivals_(arrivals) {}
+
+    void start() {
+        stop_.store(false);
+        thread_ = std::thread([this]() { run(); });
+    }
+    void stop() {
+        stop_.store(true);
+        thread_.join();
+    }
+
+    uint32_t received() const { return received_.load(std::memory_order_relaxed); }
+    int64_t lastArrival() const { return lastArrival_.load(std::memory_order_relaxed); }
+    uint64_t datagrams() const { return datagrams_; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    void run() {
+        std::string datagram;
+        while (!stop_.load(std::memory_order_relaxed)) {
+            if (!engine_.receive(datagram, 20)) {
+                continue;
+            }
+            int64_t now = MonotonicTicks();
+            datagrams_++;
+            bytes_ += datagram.size();
+            if (!datagram.empty() && (unsigned char)datagram[0] == SEQUENCE_MAGIC) {
+                datagram.erase(0, SEQUENCE_HEADER_SIZE);
+            }
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(datagram.data());
+            size_t size = datagram.size();
+            if (size >= PROTOCOL_V2_HEADER_SIZE && p[0] == PROTOCOL_V2_MAGIC && p[1] == PROTOCOL_V2_VERSION) {
+                size_t pos = PROTOCOL_V2_HEADER_SIZE;
+                while (pos < size) {
+                    size_t tag = pos++;
+                    size_t len = 0;
+                    for (int shift = 0; pos < size; shift += 7) {
+                        unsigned char byte = p[pos++];
+                        len |= (size_t)(byte & 0x7F) << shift;
+                        if (!(byte & 0x80)) break;
+                    }
+                    len = (std::min)(len, size - pos);
+                    event(datagram.data() + tag, len + (pos - tag), pos - tag, now);
+                    pos += len;
+                }
+            }
+            else if (size > 1) {
+                event(datagram.data(), size, 1, now);
+            }
+        }
+    }
+
+    // [tag][header][body] of one v1 datagram or v2 record; fragments count once complete
+    void event(const char* data, size_t size, size_t bodyOffset, int64_t now) {
+        if (data[0] != MSG_TYPE_FRAGMENT) {
+            record(data + bodyOffset, size - bodyOffset, now);
+        }
+        else if (reassembler_.add(data + bodyOffset, size - bodyOffset, assembled_)) {
+            record(assembled_.data() + 1, assembled_.size() - 1, now);
+        }
+    }
+
+    // Matches the "~<seq>" marker the load shapes put in front of each event's content
+    void record(const char* body, size_t len, int64_t now) {
+        const char* marker = static_cast<const char*>(memchr(body, '~', len));
+        if (!marker) {
+            return;
+        }
+        uint32_t seq = 0;
+        bool digits = false;
+        for (const char* p = marker + 1; p < body + len && *p >= '0' && *p <= '9'; p++) {
+            seq = seq * 10 + (uint32_t)(*p - '0');
+            digits = true;
+        }
+        if (!digits || seq >= arrivals_.size() || arrivals_[seq] != 0) {
+            return;
+        }
+        arrivals_[seq] = now;
+        lastArrival_.store(now, std::memory_order_relaxed);
+        received_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    FakeEngine& engine_;
+    std::vector<int64_t>& arrivals_;
+    std::thread thread_;
+    FragmentReassembler reassembler_;
+    std::string assembled_;
+    std::atomic<bool> stop_{ false };
+    std::atomic<uint32_t> received_{ 0 };
+    std::atomic<int64_t> lastArrival_{ 0 };
+    uint64_t datagrams_ = 0;
+    uint64_t bytes_ = 0;
+};
+
+static void Invoke(const HookCall& call) {
+    switch (call.kind) {
+    case HookCall::SAY_TEXT:     Forwarder_SayText(call.payload.data(), (int)call.payload.size()); break;
+    case HookCall::TEXT_MSG:     Forwarder_TextMsg(call.payload.data(), (int)call.payload.size()); break;
+    case HookCall::PRINT:        Forwarder_NetPrint(call.payload.data()); break;
+    case HookCall::STUFF_TEXT:   Forwarder_StuffText(call.payload.data()); break;
+    case HookCall::DEBUG_STRING: Forwarder_DebugString(call.payload.data()); break;
+    }
+}
+
+static uint64_t QueueDrops() {
+    uint64_t drops = 0;
+    for (int lane = 0; lane < LANE_COUNT; lane++) {
+        drops += g_sendQueue.lane(lane).overflowed() + g_sendQueue.lane(lane).evicted();
+    }
+    return drops;
+}
+
+static uint64_t SendDrops() {
+    uint64_t drops = 0;
+    for (int lane = 0; lane < LANE_COUNT; lane++) {
+        drops += ForwarderStats::Get(g_stats.lanes[lane].dropped[DROP_NO_ROUTE]) +
+            ForwarderStats::Get(g_stats.lanes[lane].dropped[DROP_SEND_ERROR]);
+    }
+    return drops;
+}
+
+static BenchResult RunShape(FakeEngine& engine, const BenchOptions& options, const std::string& shapeName, int protocol) {
+    BenchResult result;
+    result.shape = shapeName;
+    result.protocol = protocol;
+
+    std::unique_ptr<LoadShape> shape = MakeLoadShape(shapeName, options.seed);
+    // A burst may run past the requested count; leave room for the largest one
+    std::vector<int64_t> sent(options.events + 1024, 0);
+    std::vector<int64_t> arrivals(sent.size(), 0);
+    Receiver receiver(engine, arrivals);
+    receiver.start();
+
+    const uint64_t queueDropsBefore = QueueDrops();
+    const uint64_t sendDropsBefore = SendDrops();
+    std::vector<HookCall> calls;
+    uint32_t seq = 0;
+    int64_t producerTicks = 0;
+    const int64_t start = MonotonicTicks();
+    auto wallStart = std::chrono::steady_clock::now();
+    while (seq < options.events) {
+        calls.clear();
+        shape->nextBurst(seq, calls);
+        for (const HookCall& call : calls) {
+            int64_t before = MonotonicTicks();
+            for (uint32_t i = 0; i < call.events; i++) {
+                sent[call.firstSeq + i] = before;
+            }
+            Invoke(call);
+            producerTicks += MonotonicTicks() - before;
+        }
+        if (options.rate > 0.0) {
+            std::this_thread::sleep_until(wallStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(seq / options.rate)));
+        }
+    }
+    result.events = seq;
+
+    // Let the sender drain; stop once everything arrived or nothing did for a while
+    uint32_t lastCount = 0;
+    auto lastProgress = std::chrono::steady_clock::now();
+    while (receiver.received() < result.events &&
+        std::chrono::steady_clock::now() - lastProgress < std::chrono::milliseconds(500)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        if (receiver.received() != lastCount) {
+            lastCount = receiver.received();
+            lastProgress = std::chrono::steady_clock::now();
+        }
+    }
+    receiver.stop();
+
+    result.received = receiver.received();
+    result.queueDrops = QueueDrops() - queueDropsBefore;
+    result.sendDrops = SendDrops() - sendDropsBefore;
+    result.datagrams = receiver.datagrams();
+    result.datagramBytes = receiver.bytes();
+    result.producerNsPerEvent = result.events ? (double)TicksToNs(producerTicks) / result.events : 0.0;
+    if (result.received) {
+        result.seconds = TicksToNs(receiver.lastArrival() - start) / 1e9;
+        result.eventsPerSec = result.seconds > 0.0 ? result.received / result.seconds : 0.0;
+    }
+
+    std::vector<uint64_t> latencies;
+    latencies.reserve(result.received);
+    for (uint32_t i = 0; i < result.events; i++) {
+        if (arrivals[i]) {
+            latencies.push_back(TicksToNs(arrivals[i] - sent[i]));
+        }
+    }
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        auto at = [&](double q) {
+            size_t index = (size_t)(q * (double)(latencies.size() - 1) + 0.5);
+            return latencies[(std::min)(index, latencies.size() - 1)];
+        };
+        result.p50 = at(0.50);
+        result.p99 = at(0.99);
+        result.p999 = at(0.999);
+        result.max = latencies.back();
+    }
+    return result;
+}
+
+static bool WriteJson(const std::string& path, const BenchOptions& options, const std::vector<BenchResult>& results) {
+    FILE* out = fopen(path.c_str(), "w");
+    if (!out) {
+        return false;
+    }
+    fprintf(out, "{\n  \"format\": 1,\n");
+    fprintf(out, "  \"build\": { \"profiler\": %s, \"avx2\": %s },\n", CF_PROFILER ? "true" : "false",
+#if defined(__AVX2__)
+        "true"
+#else
+        "false"
+#endif
+    );
+    fprintf(out, "  \"options\": { \"events\": %u, \"rate\": %.0f, \"seed\": %u, \"deferred\": %s, \"reliable\": %s },\n",
+        options.events, options.rate, options.seed, options.deferred ? "true" : "false",
+        options.reliable ? "true" : "false");
+    fprintf(out, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        uint32_t dropped = r.events - r.received;
+        fprintf(out, "    { \"shape\": \"%s\", \"protocol\": %d, \"events\": %u, \"received\": %u, "
+            "\"dropped\": %u, \"drop_rate\": %.6f, \"queue_drops\": %llu, \"send_drops\": %llu, "
+            "\"seconds\": %.6f, \"events_per_sec\": %.1f, \"producer_ns_per_event\": %.1f, "
+            "\"datagrams\": %llu, \"datagram_bytes\": %llu, "
+            "\"latency_ns\": { \"p50\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu } }%s\n",
+            r.shape.c_str(), r.protocol, r.events, r.received, dropped,
+            r.events ? (double)dropped / r.events : 0.0,
+            (unsigned long long)r.queueDrops, (unsigned long long)r.sendDrops,
+            r.seconds, r.eventsPerSec, r.producerNsPerEvent,
+            (unsigned long long)r.datagrams, (unsigned long long)r.datagramBytes,
+            (unsigned long long)r.p50, (unsigned long long)r.p99, (unsigned long long)r.p999,
+            (unsigned long long)r.max, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    return fclose(out) == 0;
+}
+
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+#define CF_HAVE_TSC 1
+static uint64_t ReadCycles() { return __rdtsc(); }
+#else
+#define CF_HAVE_TSC 0
+#endif
+
+struct CleanKernel {
+    const char* name;
+    size_t (*clean)(const char* input, size_t len, char* out);
+};
+
+// Bytes per TSC cycle of each CleanMessage kernel. The TSC ticks at the nominal clock, so
+// turbo and power states shift all kernels alike; the best of several passes is reported.
+static bool RunKernels(const BenchOptions& options) {
+#if !CF_HAVE_TSC
+    fprintf(stderr, "--kernels needs a cycle counter (x86 only)\n");
+    return false;
+#else
+    std::vector<CleanKernel> kernels = { { "scalar", CleanMessageScalar } };
+#if CF_HAVE_SSE2
+    kernels.push_back({ "sse2", CleanMessageSSE2 });
+#endif
+    // Like the tests: only builds that may execute AVX2 (the _AVX2 DLL, -DCF_AVX2=ON) run it
+#if CF_HAVE_AVX2 && defined(__AVX2__)
+    kernels.push_back({ "avx2", CleanMessageAVX2 });
+#endif
+    static const size_t lengths[] = { 16, 64, 256, 1024, 4096 };
+    // Share of bytes CleanMessage drops: none, a color-coded chat line, noisy debug output
+    static const double densities[] = { 0.0, 1.0 / 64, 1.0 / 8 };
+    const size_t bytesPerPass = options.quick ? (1u << 20) : (16u << 20);
+    const int passes = options.quick ? 2 : 5;
+
+    std::mt19937 rng(options.seed);
+    std::vector<char> input(lengths[sizeof(lengths) / sizeof(lengths[0]) - 1]), out(input.size() + 1);
+    printf("%-8s %6s %8s %12s\n", "kernel", "len", "ctrl%", "bytes/cycle");
+    size_t sink = 0;
+    for (double density : densities) {
+        for (size_t len : lengths) {
+            for (size_t i = 0; i < len; i++) {
+                bool control = std::uniform_real_distribution<double>(0.0, 1.0)(rng) < density;
+                // 0x05-0x08 and 0x0E-0x1F are always dropped; text stays printable ASCII
+                input[i] = (char)(control ? 0x05 + rng() % 4 : 0x20 + rng() % 0x5F);
+            }
+            size_t calls = (std::max)(bytesPerPass / len, (size_t)1);
+            for (const CleanKernel& kernel : kernels) {
+                uint64_t best = UINT64_MAX;
+                for (int pass = 0; pass < passes; pass++) {
+                    uint64_t start = ReadCycles();
+                    for (size_t call = 0; call < calls; call++) {
+                        sink += kernel.clean(input.data(), len, out.data());
+                    }
+                    best = (std::min)(best, ReadCycles() - start);
+                }
+                printf("%-8s %6u %7.1f%% %12.2f\n", kernel.name, (unsigned)len, density * 100.0,
+                    best ? (double)(calls * len) / (double)best : 0.0);
+            }
+        }
+    }
+    fflush(stdout);
+    return sink > 0;
+#endif
+}
+
+static void Usage() {
+    fprintf(stderr, "usage: cf_pipeline_bench [--quick] [--events N] [--rate EVENTS_PER_SEC] "
+        "[--protocol 1|2] [--shape NAME] [--seed N] [--deferred] [--reliable] [--json PATH]\n"
+        "       cf_pipeline_bench --kernels [--quick] [--seed N]\nshapes:");
+    for (int i = 0; i < g_loadShapeCount; i++) {
+        fprintf(stderr, " %s", g_loadShapeNames[i]);
+    }
+    fprintf(stderr, "\n");
+}
+
+static bool ParseOptions(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--quick") {
+            options.events = 2000;
+            options.quick = true;
+        }
+        else if (arg == "--kernels") {
+            options.kernels = true;
+        }
+        else if (arg == "--events" && hasValue) {
+            options.events = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--rate" && hasValue) {
+            options.rate = (std::max)(atof(argv[++i]), 0.0);
+        }
+        else if (arg == "--protocol" && hasValue) {
+            int protocol = atoi(argv[++i]);
+            if (protocol != 1 && protocol != 2) return false;
+            options.protocols = { protocol };
+        }
+        else if (arg == "--shape" && hasValue) {
+            options.shapes.push_back(argv[++i]);
+            if (!MakeLoadShape(options.shapes.back(), 0)) return false;
+        }
+        else if (arg == "--seed" && hasValue) {
+            options.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--deferred") {
+            options.deferred = true;
+        }
+        else if (arg == "--reliable") {
+            options.reliable = true;
+        }
+        else if (arg == "--json" && hasValue) {
+            options.jsonPath = argv[++i];
+        }
+        else {
+            return false;
+        }
+    }
+    if (options.shapes.empty()) {
+        options.shapes.assign(g_loadShapeNames, g_loadShapeNames + g_loadShapeCount);
+    }
+    return options.events > 0;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        Usage();
+        return 2;
+    }
+    if (options.kernels) {
+        return RunKernels(options) ? 0 : 1;
+    }
+
+    FakeEngine engine;
+    if (!engine.start()) {
+        fprintf(stderr, "fake engine failed to start\n");
+        return 1;
+    }
+
+    printf("%-18s %5s %8s %8s %7s %11s %10s %10s %10s %9s\n", "shape", "proto", "events", "recv",
+        "drop%", "events/s", "p50 us", "p99 us", "p999 us", "prod ns");
+    std::vector<BenchResult> results;
+    bool ok = true;
+    engine.setCvar(CVAR_DEFERRED, options.deferred ? "1" : "0");
+    engine.setCvar(CVAR_RELIABLE, options.reliable ? "1" : "0");
+    for (int protocol : options.protocols) {
+        engine.setCvar(CVAR_PROTOCOL, protocol == 2 ? "2" : "1");
+        engine.frame();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        for (const std::string& shape : options.shapes) {
+            BenchResult r = RunShape(engine, options, shape, protocol);
+            printf("%-18s %5d %8u %8u %6.2f%% %11.0f %10.1f %10.1f %10.1f %9.0f\n", r.shape.c_str(), r.protocol,
+                r.events, r.received, r.events ? 100.0 * (r.events - r.received) / r.events : 0.0,
+                r.eventsPerSec, r.p50 / 1000.0, r.p99 / 1000.0, r.p999 / 1000.0, r.producerNsPerEvent);
+            fflush(stdout);
+            ok = ok && r.received > 0;
+            results.push_back(r);
+        }
+    }
+    engine.stop();
+
+    if (!options.jsonPath.empty() && !WriteJson(options.jsonPath, options, results)) {
+        fprintf(stderr, "cannot write %s\n", options.jsonPath.c_str());
+        return 1;
+    }
+    return ok ? 0 : 1;
+}
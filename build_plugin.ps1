@@ -3,10 +3,12 @@
 # .\build_plugin.ps1                  - Просто собрать (Release + AVX2)
 # .\build_plugin.ps1 -Package         - Собрать и создать ZIP архивы с версией
 # .\build_plugin.ps1 -CopyTo "C:\Path" - Собрать и скопировать в игру
+# .\build_plugin.ps1 -NoProfiler     - Собрать без профилировщика задержек (CF_PROFILER=0)
 
 param (
     [switch]$Package = $false,
-    [string]$CopyTo = ""
+    [string]$CopyTo = "",
+    [switch]$NoProfiler = $false
 )
 
 $ErrorActionPreference = "Stop"
@@ -51,6 +53,7 @@ foreach ($config in $configurations) {
         "/p:Configuration=$config",
         "/p:Platform=$platform",
         "/p:SolutionDir=$solutionDirStr",
+        "/p:ChatForwarderDefines=$(if ($NoProfiler) { 'CF_PROFILER=0' } else { '' })",
         "/m",
         "/v:minimal",
         "/nologo"
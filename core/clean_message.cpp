@@ -0,0 +1,99 @@
+// clean_message.cpp
+#include "forwarder.h"
+
+// CleanMessage keeps printable bytes (>= 0x20, including UTF-8), GoldSrc color codes
+// 0x01-0x04, \r, \n and \t, and drops every other byte below 0x20 (bell, NUL, ...).
+// The vector kernels test a whole block at once and copy it through untouched when
+// nothing has to go, which is the common case; blocks with a dropped byte fall back
+// to the scalar filter. Output never grows, so out needs len + 1 bytes (NUL included).
+
+static inline bool IsKeptByte(unsigned char c) {
+    return c >= 0x20 || (c >= 0x01 && c <= 0x04) || c == '\r' || c == '\n' || c == '\t';
+}
+
+static inline size_t CleanBlockScalar(const char* input, size_t len, char* out) {
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (IsKeptByte((unsigned char)input[i])) {
+            out[n++] = input[i];
+        }
+    }
+    return n;
+}
+
+size_t CleanMessageScalar(const char* input, size_t len, char* out) {
+    size_t n = CleanBlockScalar(input, len, out);
+    out[n] = '\0';
+    return n;
+}
+
+#if CF_HAVE_SSE2
+// Lanes holding a byte CleanMessage drops: c <= 0x1F and not in {1..4, \t, \n, \r}
+static inline __m128i DropMaskSSE2(__m128i v) {
+    const __m128i low = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v);
+    const __m128i minus1 = _mm_sub_epi8(v, _mm_set1_epi8(1));
+    __m128i keep = _mm_cmpeq_epi8(_mm_min_epu8(minus1, _mm_set1_epi8(3)), minus1);
+    keep = _mm_or_si128(keep, _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    keep = _mm_or_si128(keep, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+    keep = _mm_or_si128(keep, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+    return _mm_andnot_si128(keep, low);
+}
+
+size_t CleanMessageSSE2(const char* input, size_t len, char* out) {
+    size_t i = 0, n = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        if (_mm_movemask_epi8(DropMaskSSE2(v)) == 0) {
+            // n <= i, so the store stays inside the first len bytes of out
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + n), v);
+            n += 16;
+        }
+        else {
+            n += CleanBlockScalar(input + i, 16, out + n);
+        }
+    }
+    n += CleanBlockScalar(input + i, len - i, out + n);
+    out[n] = '\0';
+    return n;
+}
+#endif
+
+#if CF_HAVE_AVX2
+static inline __m256i DropMaskAVX2(__m256i v) {
+    const __m256i low = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1F)), v);
+    const __m256i minus1 = _mm256_sub_epi8(v, _mm256_set1_epi8(1));
+    __m256i keep = _mm256_cmpeq_epi8(_mm256_min_epu8(minus1, _mm256_set1_epi8(3)), minus1);
+    keep = _mm256_or_si256(keep, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+    keep = _mm256_or_si256(keep, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+    keep = _mm256_or_si256(keep, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+    return _mm256_andnot_si256(keep, low);
+}
+
+size_t CleanMessageAVX2(const char* input, size_t len, char* out) {
+    size_t i = 0, n = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+        if (_mm256_movemask_epi8(DropMaskAVX2(v)) == 0) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + n), v);
+            n += 32;
+        }
+        else {
+            n += CleanBlockScalar(input + i, 32, out + n);
+        }
+    }
+    n += CleanBlockScalar(input + i, len - i, out + n);
+    out[n] = '\0';
+    return n;
+}
+#endif
+
+// The _AVX2 build gets the AVX2 kernel, the base build SSE2; MetaHookSv picks the DLL per CPU
+size_t CleanMessage(const char* input, size_t len, char* out) {
+#if CF_HAVE_AVX2 && defined(__AVX2__)
+    return CleanMessageAVX2(input, len, out);
+#elif CF_HAVE_SSE2
+    return CleanMessageSSE2(input, len, out);
+#else
+    return CleanMessageScalar(input, len, out);
+#endif
+}
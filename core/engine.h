@@ -0,0 +1,73 @@
+// engine.h
+// Engine-interface shim: everything the core needs from the game client. The MetaHook
+// adapter (plugins.cpp) fills it from gEngfuncs and the registered cvars; the fake engine
+// under tests/ fills it with stubs.
+#ifndef CF_ENGINE_H
+#define CF_ENGINE_H
+
+// Every cvar the core reads, in registration order
+enum CvarId {
+    CVAR_SERVER_IP,
+    CVAR_SERVER_PORT,
+    CVAR_LISTEN_PORT,
+    CVAR_ENABLED,
+    CVAR_DEBUG,
+    CVAR_LISTEN_ONLY,
+    CVAR_COMMAND_DELAY,
+    CVAR_LANE_BYTES,
+    CVAR_LANE_DROP,
+    CVAR_LANE_WEIGHTS,
+    CVAR_PROTOCOL,
+    CVAR_FRAME_MTU,
+    CVAR_FLUSH_US,
+    CVAR_DEDUP,
+    CVAR_DEDUP_WINDOW,
+    CVAR_DEDUP_TAGS,
+    CVAR_CMD_PER_FRAME,
+    CVAR_CMD_FRAME_US,
+    CVAR_CMD_RATE,
+    CVAR_CMD_BURST,
+    CVAR_STATS_INTERVAL,
+    CVAR_DEFERRED,
+    CVAR_RELIABLE,
+    CVAR_RETRANSMIT_BYTES,
+    CVAR_SPOOL,
+    CVAR_SPOOL_PATH,
+    CVAR_SPOOL_BYTES,
+    CVAR_SPOOL_RATE,
+    CVAR_SPOOL_AUTO,
+    CVAR_DESTINATIONS,
+    CVAR_FILTER,
+    CVAR_FILTER_FILE,
+    CVAR_ENCODING,
+    CVAR_CMD_REPLY_MS,
+    CVAR_COUNT
+};
+
+struct CvarSpec {
+    const char* name;
+    const char* defaultValue;
+};
+
+struct CommandSpec {
+    const char* name;
+    void (*handler)(void);
+};
+
+extern const CvarSpec g_cvarSpecs[CVAR_COUNT];
+extern const CommandSpec g_commandSpecs[];
+extern const int g_commandCount;
+
+// Game thread only, except Con_Printf which the core also calls from hooks
+struct EngineInterface {
+    void (*Con_Printf)(const char* fmt, ...);
+    void (*ClientCmd)(const char* command);
+    const char* (*CvarString)(CvarId id);     // NULL while the cvar is not registered
+    void (*CvarSet)(CvarId id, const char* value);
+    int (*Cmd_Argc)(void);
+    const char* (*Cmd_Argv)(int index);
+};
+
+extern EngineInterface g_engine;
+
+#endif // CF_ENGINE_H
@@ -0,0 +1,195 @@
+// filter.cpp
+#include "forwarder.h"
+
+static unsigned char FoldCase(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + 'a' - 'A') : c;
+}
+
+// "*", "chat,net" or a numeric mask; 0 if nothing valid was given
+static int ParseFilterTags(const std::string& text) {
+    if (text == "*") {
+        return ALL_TAGS;
+    }
+    if (!text.empty() && text[0] >= '0' && text[0] <= '9') {
+        return atoi(text.c_str()) & ALL_TAGS;
+    }
+    static const char* const names[LANE_COUNT] = { "chat", "game", "net", "sys", "stuff" };
+    int tags = 0;
+    for (size_t pos = 0; pos <= text.size(); ) {
+        size_t comma = text.find(',', pos);
+        std::string name = text.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+        std::transform(name.begin(), name.end(), name.begin(), [](char c) { return (char)FoldCase((unsigned char)c); });
+        int lane = 0;
+        while (lane < LANE_COUNT && name != names[lane]) lane++;
+        if (lane == LANE_COUNT) {
+            return 0;
+        }
+        tags |= 1 << lane;
+        if (comma == std::string::npos) {
+            break;
+        }
+        pos = comma + 1;
+    }
+    return tags;
+}
+
+bool FilterSet::addRule(const char* line, std::string& error) {
+    std::string text(line);
+    while (!text.empty() && (unsigned char)text.back() <= ' ') {
+        text.pop_back();
+    }
+    size_t start = text.find_first_not_of(" \t");
+    if (start == std::string::npos || text[start] == '#') {
+        return true;
+    }
+
+    size_t tagsEnd = text.find_first_of(" \t", start);
+    size_t op = tagsEnd == std::string::npos ? std::string::npos : text.find_first_not_of(" \t", tagsEnd);
+    if (op == std::string::npos || (text[op] != '+' && text[op] != '-') ||
+        op + 1 >= text.size() || (text[op + 1] != ' ' && text[op + 1] != '\t')) {
+        error = "expected <tags> <+|-> <pattern>";
+        return false;
+    }
+    int tags = ParseFilterTags(text.substr(start, tagsEnd - start));
+    if (!tags) {
+        error = "unknown tags " + text.substr(start, tagsEnd - start);
+        return false;
+    }
+    size_t pattern = text.find_first_not_of(" \t", op + 1);
+    if (pattern == std::string::npos) {
+        error = "empty pattern";
+        return false;
+    }
+    if (text.size() - pattern > MAX_FILTER_PATTERN) {
+        error = "pattern longer than " + std::to_string(MAX_FILTER_PATTERN) + " bytes";
+        return false;
+    }
+    if (rules_.size() >= MAX_FILTER_RULES) {
+        error = "more than " + std::to_string(MAX_FILTER_RULES) + " rules";
+        return false;
+    }
+
+    rules_.emplace_back();
+    Rule& rule = rules_.back();
+    rule.tags = tags;
+    rule.exclude = text[op] == '-';
+    rule.pattern = text.substr(pattern);
+    return true;
+}
+
+void FilterSet::compile() {
+    // Alphabet: class 0 for every byte no pattern uses, one class per folded byte otherwise
+    memset(classOf_, 0, sizeof(classOf_));
+    classes_ = 1;
+    for (const Rule& rule : rules_) {
+        for (char c : rule.pattern) {
+            unsigned char folded = FoldCase((unsigned char)c);
+            if (!classOf_[folded]) {
+                classOf_[folded] = (unsigned char)classes_++;
+            }
+        }
+    }
+    for (int c = 'A'; c <= 'Z'; c++) {
+        classOf_[c] = classOf_[FoldCase((unsigned char)c)];
+    }
+
+    // Trie; next_ entries of -1 are filled in below
+    nodes_.assign(1, Node());
+    next_.assign(classes_, -1);
+    ruleNext_.assign(rules_.size(), -1);
+    includeTags_ = excludeTags_ = ruleTags_ = 0;
+    for (size_t index = 0; index < rules_.size(); index++) {
+        const Rule& rule = rules_[index];
+        int32_t state = 0;
+        for (char c : rule.pattern) {
+            int cls = classOf_[(unsigned char)c];
+            if (next_[state * classes_ + cls] < 0) {
+                next_[state * classes_ + cls] = (int32_t)nodes_.size();
+                nodes_.push_back(Node());
+                next_.resize(next_.size() + classes_, -1);
+            }
+            state = next_[state * classes_ + cls];
+        }
+        ruleNext_[index] = nodes_[state].firstRule;
+        nodes_[state].firstRule = (int32_t)index;
+        (rule.exclude ? nodes_[state].excludeTags : nodes_[state].includeTags) |= rule.tags;
+        (rule.exclude ? excludeTags_ : includeTags_) |= rule.tags;
+        ruleTags_ |= rule.tags;
+    }
+
+    // Breadth first: failure links complete the transitions into a DFA and carry the
+    // suffixes' tag masks and output links down to each node
+    std::vector<int32_t> fail(nodes_.size(), 0);
+    std::vector<int32_t> queue;
+    for (int cls = 0; cls < classes_; cls++) {
+        int32_t child = next_[cls];
+        if (child < 0) {
+            next_[cls] = 0;
+        }
+        else {
+            queue.push_back(child);
+        }
+    }
+    for (size_t head = 0; head < queue.size(); head++) {
+        int32_t state = queue[head];
+        Node& node = nodes_[state];
+        const Node& suffix = nodes_[fail[state]];
+        node.excludeTags |= suffix.excludeTags;
+        node.includeTags |= suffix.includeTags;
+        node.outLink = suffix.firstRule >= 0 ? fail[state] : suffix.outLink;
+        for (int cls = 0; cls < classes_; cls++) {
+            int32_t& child = next_[state * classes_ + cls];
+            int32_t fallback = next_[fail[state] * classes_ + cls];
+            if (child < 0) {
+                child = fallback;
+            }
+            else {
+                fail[child] = fallback;
+                queue.push_back(child);
+            }
+        }
+    }
+}
+
+bool FilterSet::allows(char tag, const char* text, size_t len) const {
+    int bit = 1 << SendQueue::LaneOf(tag);
+    if (!(ruleTags_ & bit)) {
+        return true;
+    }
+    bool included = !(includeTags_ & bit);
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text);
+    int32_t state = 0;
+    for (size_t i = 0; i < len; i++) {
+        state = next_[state * classes_ + classOf_[bytes[i]]];
+        const Node& node = nodes_[state];
+        if (!((node.excludeTags | (included ? 0 : node.includeTags)) & bit)) {
+            continue;
+        }
+        // A hit: find the rules behind it, exclusions first
+        for (int32_t at = node.firstRule >= 0 ? state : node.outLink; at > 0; at = nodes_[at].outLink) {
+            for (int32_t index = nodes_[at].firstRule; index >= 0; index = ruleNext_[index]) {
+                const Rule& rule = rules_[index];
+                if ((rule.tags & bit) && rule.exclude) {
+                    rule.hits.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+            }
+        }
+        if (!included) {
+            for (int32_t at = node.firstRule >= 0 ? state : node.outLink; at > 0 && !included; at = nodes_[at].outLink) {
+                for (int32_t index = nodes_[at].firstRule; index >= 0; index = ruleNext_[index]) {
+                    const Rule& rule = rules_[index];
+                    if ((rule.tags & bit) && !rule.exclude) {
+                        rule.hits.fetch_add(1, std::memory_order_relaxed);
+                        included = true;
+                        break;
+                    }
+                }
+            }
+        }
+        if (included && !(excludeTags_ & bit)) {
+            return true;
+        }
+    }
+    return included;
+}
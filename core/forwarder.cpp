@@ -0,0 +1,1312 @@
+// forwarder.cpp
+// Core state, config publishing, the reactor work item and console reports
+#include "forwarder.h"
+#include <cmath>
+#include <cstdarg>
+
+MessageQueue g_messageQueue;
+CommandScheduler g_commandScheduler;
+SendQueue g_sendQueue;
+DestinationCache g_destination;
+DedupFilter g_dedup;
+ForwarderStats g_stats;
+#if CF_PROFILER
+LatencyProfiler g_profiler;
+#endif
+ConfigStore g_config;
+NackQueue g_nacks;
+ReplyQueue g_replies;
+Spool g_spool;
+FilterStore g_filters;
+std::atomic<bool> g_shutdownReactor(false);
+
+const CvarSpec g_cvarSpecs[CVAR_COUNT] = {
+    { "cf_server_ip", "127.0.0.1" },
+    { "cf_server_port", "26000" },
+    { "cf_listen_port", "26001" },
+    { "cf_enabled", "1" },
+    { "cf_debug", "0" },
+    { "cf_listen_only", "0" },
+    { "cf_command_delay", "0" },
+    { "cf_lane_bytes", "65536 65536 262144 262144 131072" },
+    { "cf_lane_drop", "0 0 1 1 0" },
+    { "cf_lane_weights", "8 8 2 1 2" },
+    { "cf_protocol", "1" },
+    { "cf_frame_mtu", "1400" },
+    { "cf_flush_us", "2000" },
+    { "cf_dedup", "0" },
+    { "cf_dedup_window", "50" },
+    { "cf_dedup_tags", "31" },
+    { "cf_cmd_per_frame", "1" },
+    { "cf_cmd_frame_us", "0" },
+    { "cf_cmd_rate", "0" },
+    { "cf_cmd_burst", "1" },
+    { "cf_stats_interval", "0" },
+    { "cf_deferred", "0" },
+    { "cf_reliable", "0" },
+    { "cf_retransmit_bytes", "262144" },
+    { "cf_spool", "0" },
+    { "cf_spool_path", "chatforwarder_spool" },
+    { "cf_spool_bytes", "16777216" },
+    { "cf_spool_rate", "500" },
+    { "cf_spool_auto", "1" },
+    { "cf_destinations", "" },
+    { "cf_filter", "0" },
+    { "cf_filter_file", "chatforwarder_filter.txt" },
+    { "cf_encoding", "0" },
+    { "cf_cmd_reply_ms", "250" },
+};
+
+const CommandSpec g_commandSpecs[] = {
+    { "cf_dedup_stats", Cmd_DedupStats },
+    { "cf_cmd_stats", Cmd_CommandStats },
+    { "cf_stats", Cmd_Stats },
+    { "cf_latency", Cmd_Latency },
+    { "cf_spool_replay", Cmd_SpoolReplay },
+    { "cf_dest_add", Cmd_DestAdd },
+    { "cf_dest_remove", Cmd_DestRemove },
+    { "cf_dest_list", Cmd_DestList },
+    { "cf_filter_reload", Cmd_FilterReload },
+    { "cf_filter_stats", Cmd_FilterStats },
+};
+const int g_commandCount = sizeof(g_commandSpecs) / sizeof(g_commandSpecs[0]);
+
+// "" while the cvar is unset or not registered yet
+static const char* CvarValue(CvarId id) {
+    const char* value = g_engine.CvarString ? g_engine.CvarString(id) : nullptr;
+    return value ? value : "";
+}
+
+static int CvarInt(CvarId id, int fallback) {
+    const char* value = CvarValue(id);
+    return value[0] ? atoi(value) : fallback;
+}
+
+static double CvarDouble(CvarId id, double fallback) {
+    const char* value = CvarValue(id);
+    return value[0] ? atof(value) : fallback;
+}
+
+// Parses a space-separated per-lane list ("CHAT GAME NET SYS STUFF"); missing entries keep defaults
+static void CvarLaneList(CvarId id, const int (&defaults)[LANE_COUNT], int (&out)[LANE_COUNT]) {
+    memcpy(out, defaults, sizeof(out));
+    const char* p = CvarValue(id);
+    for (int lane = 0; lane < LANE_COUNT && *p; lane++) {
+        char* end;
+        long value = strtol(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        out[lane] = (int)value;
+        p = end;
+    }
+}
+
+// Whitespace-separated cf_destinations entries
+static std::vector<std::string> DestinationEntries(const char* text) {
+    std::vector<std::string> entries;
+    for (const char* p = text; *p; ) {
+        while (*p && (unsigned char)*p <= ' ') p++;
+        const char* end = p;
+        while (*end && (unsigned char)*end > ' ') end++;
+        if (end > p) entries.emplace_back(p, end);
+        p = end;
+    }
+    return entries;
+}
+
+// "host:port" or "host:port/tags"; tags is a cf_dedup_tags style mask and defaults to all
+static bool ParseDestination(const std::string& entry, DestinationSpec& spec) {
+    spec = DestinationSpec();
+    spec.tags = ALL_TAGS;
+    std::string address = entry.substr(0, entry.find('/'));
+    if (address.size() < entry.size()) {
+        spec.tags = atoi(entry.c_str() + address.size() + 1) & ALL_TAGS;
+    }
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon >= sizeof(spec.host)) {
+        return false;
+    }
+    memcpy(spec.host, address.data(), colon);
+    spec.port = atoi(address.c_str() + colon + 1);
+    return spec.port > 0 && spec.port <= 65535 && spec.tags != 0;
+}
+
+// DestinationCache: numeric targets are parsed in update(), hostnames on the resolver thread
+void DestinationCache::Resolve(const char* host, const char* port, const DestinationSpec* extras, int extraCount,
+    bool numericOnly, ResolvedDestination& dest)
+{
+    bool (*resolve)(const char*, int, sockaddr_in&) = numericOnly ? ParseAddress : ResolveAddress;
+    dest.valid = resolve(host, atoi(port), dest.addr);
+    dest.complete = dest.valid;
+    dest.extraCount = extraCount;
+    for (int i = 0; i < extraCount; i++) {
+        dest.extras[i].tags = extras[i].tags;
+        dest.extras[i].valid = resolve(extras[i].host, extras[i].port, dest.extras[i].addr);
+        dest.complete = dest.complete && dest.extras[i].valid;
+    }
+}
+
+void DestinationCache::update(const char* host, const char* port, const DestinationSpec* extras, int extraCount)
+{
+    if (!host) host = "";
+    if (!port) port = "";
+    if (strcmp(host, host_) == 0 && strcmp(port, port_) == 0 && extraCount == extraCount_ &&
+        memcmp(extras, extras_, extraCount * sizeof(DestinationSpec)) == 0) {
+        return;
+    }
+    ResolvedDestination parsed;
+    Resolve(host, port, extras, extraCount, true, parsed);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        snprintf(host_, sizeof(host_), "%s", host);
+        snprintf(port_, sizeof(port_), "%s", port);
+        memcpy(extras_, extras, extraCount * sizeof(DestinationSpec));
+        extraCount_ = extraCount;
+        parsed.generation = ++generation_;
+        parsed.published = published_.load(std::memory_order_relaxed) + 1;
+        resolved_ = parsed;
+        published_.store(parsed.published, std::memory_order_release);
+    }
+    if (!parsed.complete) {
+        if (!resolver_.joinable()) {
+            resolver_ = std::thread(&DestinationCache::run, this);
+        }
+        wake_.set();
+    }
+}
+
+void DestinationCache::publish(const ResolvedDestination& dest)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (dest.generation != generation_) {
+        return; // the config changed while it was being resolved
+    }
+    resolved_ = dest;
+    resolved_.published = published_.load(std::memory_order_relaxed) + 1;
+    published_.store(resolved_.published, std::memory_order_release);
+}
+
+void DestinationCache::run()
+{
+    uint32_t attempted = 0;
+    while (!stopping_.load(std::memory_order_acquire)) {
+        char host[sizeof(host_)];
+        char port[sizeof(port_)];
+        DestinationSpec extras[MAX_DESTINATIONS - 1];
+        int extraCount;
+        uint32_t generation;
+        bool complete;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            memcpy(host, host_, sizeof(host));
+            memcpy(port, port_, sizeof(port));
+            memcpy(extras, extras_, sizeof(extras));
+            extraCount = extraCount_;
+            generation = generation_;
+            complete = resolved_.complete;
+        }
+        // Nothing new: sleep until the config changes, or retry the targets that failed
+        if (generation == attempted && wake_.wait(complete ? -1 : DESTINATION_RETRY_MS)) {
+            continue;
+        }
+        if (stopping_.load(std::memory_order_acquire)) {
+            break;
+        }
+        ResolvedDestination dest;
+        Resolve(host, port, extras, extraCount, false, dest);
+        dest.generation = generation;
+        attempted = generation;
+        publish(dest);
+    }
+}
+
+void DestinationCache::stop()
+{
+    if (resolver_.joinable()) {
+        // Waits out a getaddrinfo call in progress
+        stopping_.store(true, std::memory_order_release);
+        wake_.set();
+        resolver_.join();
+        stopping_.store(false, std::memory_order_relaxed);
+    }
+}
+
+// Compiles cf_filter_file and publishes it; the rules in use stay if the file is missing
+static bool LoadFilter(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        g_engine.Con_Printf("[ChatForwarder] Cannot open filter file %s\n", path);
+        return false;
+    }
+    std::unique_ptr<FilterSet> set(new FilterSet());
+    char line[MAX_FILTER_PATTERN + 64];
+    int lineNumber = 0;
+    int errors = 0;
+    while (fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        if (!strchr(line, '\n') && !feof(file)) {
+            // Longer than any valid rule: report it once and skip the rest of the line
+            int c;
+            while ((c = fgetc(file)) != EOF && c != '\n') {}
+            g_engine.Con_Printf("[ChatForwarder] %s:%d: line too long\n", path, lineNumber);
+            errors++;
+            continue;
+        }
+        std::string error;
+        if (!set->addRule(line, error)) {
+            g_engine.Con_Printf("[ChatForwarder] %s:%d: %s\n", path, lineNumber, error.c_str());
+            errors++;
+        }
+    }
+    fclose(file);
+    set->compile();
+    g_engine.Con_Printf("[ChatForwarder] Loaded %u filter rule(s) from %s, %d error(s)\n",
+        (unsigned)set->size(), path, errors);
+    g_filters.publish(std::move(set));
+    return true;
+}
+
+void RefreshConfig(void)
+{
+    // Last string seen per cvar; a rebuild happens only when one of them differs
+    static std::string lastSeen[CVAR_COUNT];
+    static bool published = false;
+
+    bool changed = !published;
+    for (int i = 0; i < CVAR_COUNT; i++) {
+        const char* value = CvarValue((CvarId)i);
+        if (lastSeen[i] != value) {
+            lastSeen[i] = value;
+            changed = true;
+        }
+    }
+    if (!changed) {
+        return;
+    }
+    // The rule file is read again only when cf_filter or cf_filter_file change; cf_filter_reload otherwise
+    static std::string filterLoaded;
+    std::string filterKey = lastSeen[CVAR_FILTER] + " " + lastSeen[CVAR_FILTER_FILE];
+
+    ConfigSnapshot cfg;
+    cfg.enabled = CvarInt(CVAR_ENABLED, 0) != 0;
+    cfg.debug = CvarInt(CVAR_DEBUG, 0) > 0;
+    cfg.listenOnly = CvarInt(CVAR_LISTEN_ONLY, 0) != 0;
+    cfg.filter = CvarInt(CVAR_FILTER, 0) != 0;
+    cfg.encoding = CvarInt(CVAR_ENCODING, 0) == 1 ? 1 : 0;
+    cfg.commandDelay = CvarDouble(CVAR_COMMAND_DELAY, 0.0);
+    cfg.commandsPerFrame = (std::max)(CvarInt(CVAR_CMD_PER_FRAME, 1), 1);
+    cfg.commandFrameUs = (std::max)(CvarInt(CVAR_CMD_FRAME_US, 0), 0);
+    cfg.commandRate = (std::max)(CvarDouble(CVAR_CMD_RATE, 0.0), 0.0);
+    cfg.commandBurst = (std::max)(CvarDouble(CVAR_CMD_BURST, 1.0), 1.0);
+    cfg.commandReplyMs = (std::max)(CvarInt(CVAR_CMD_REPLY_MS, 250), 0);
+    if (cfg.commandRate <= 0.0 && cfg.commandDelay > 0.0) {
+        // Legacy cf_command_delay: a minimum gap is a bucket of one token refilled every delay seconds
+        cfg.commandRate = 1.0 / cfg.commandDelay;
+        cfg.commandBurst = 1.0;
+    }
+    cfg.statsInterval = (std::max)(CvarDouble(CVAR_STATS_INTERVAL, 0.0), 0.0);
+    cfg.deferred = CvarInt(CVAR_DEFERRED, 0) != 0;
+    cfg.reliable = CvarInt(CVAR_RELIABLE, 0) != 0;
+    cfg.retransmitBytes = (std::min)((std::max)((size_t)(std::max)(CvarInt(CVAR_RETRANSMIT_BYTES,
+        (int)DEFAULT_RETRANSMIT_BYTES), 0), MIN_RETRANSMIT_BYTES), MAX_RETRANSMIT_BYTES);
+    cfg.spool = CvarInt(CVAR_SPOOL, 0) != 0;
+    snprintf(cfg.spoolPath, sizeof(cfg.spoolPath), "%s", CvarValue(CVAR_SPOOL_PATH));
+    cfg.spoolBytes = (std::min)((std::max)((size_t)(std::max)(CvarInt(CVAR_SPOOL_BYTES,
+        (int)DEFAULT_SPOOL_BYTES), 0), MIN_SPOOL_BYTES), MAX_SPOOL_BYTES);
+    cfg.spoolRate = (std::max)(CvarDouble(CVAR_SPOOL_RATE, 0.0), 0.0);
+    cfg.spoolAuto = CvarInt(CVAR_SPOOL_AUTO, 1) != 0;
+    int listenPort = CvarInt(CVAR_LISTEN_PORT, DEFAULT_LISTEN_PORT);
+    cfg.listenPort = (listenPort > 0 && listenPort <= 65535) ? listenPort : DEFAULT_LISTEN_PORT;
+    static const int defaultLaneBytes[LANE_COUNT] = { 65536, 65536, 262144, 262144, 131072 };
+    static const int defaultLaneDrop[LANE_COUNT] = { 0, 0, 1, 1, 0 };
+    static const int defaultLaneWeights[LANE_COUNT] = { 8, 8, 2, 1, 2 };
+    int laneBytes[LANE_COUNT], laneDrop[LANE_COUNT], laneWeights[LANE_COUNT];
+    CvarLaneList(CVAR_LANE_BYTES, defaultLaneBytes, laneBytes);
+    CvarLaneList(CVAR_LANE_DROP, defaultLaneDrop, laneDrop);
+    CvarLaneList(CVAR_LANE_WEIGHTS, defaultLaneWeights, laneWeights);
+    for (int lane = 0; lane < LANE_COUNT; lane++) {
+        cfg.laneBytes[lane] = (size_t)(std::max)(laneBytes[lane], 0);
+        cfg.laneDropOldest[lane] = laneDrop[lane] != 0;
+        cfg.laneWeights[lane] = (std::max)(laneWeights[lane], 1);
+    }
+    cfg.protocol = CvarInt(CVAR_PROTOCOL, 1);
+    cfg.frameMtu = (std::min)((std::max)((size_t)(std::max)(CvarInt(CVAR_FRAME_MTU, (int)DEFAULT_FRAME_MTU), 0),
+        MIN_FRAME_MTU), MAX_FRAME_MTU);
+    cfg.flushUs = (std::max)(CvarInt(CVAR_FLUSH_US, 0), 0);
+    cfg.dedup = CvarInt(CVAR_DEDUP, 0) != 0;
+    cfg.dedupWindowMs = (uint32_t)(std::max)(CvarInt(CVAR_DEDUP_WINDOW, 0), 0);
+    cfg.dedupTags = CvarInt(CVAR_DEDUP_TAGS, 0);
+    snprintf(cfg.serverIp, sizeof(cfg.serverIp), "%s", CvarValue(CVAR_SERVER_IP));
+    snprintf(cfg.serverPort, sizeof(cfg.serverPort), "%s", CvarValue(CVAR_SERVER_PORT));
+    for (const std::string& entry : DestinationEntries(CvarValue(CVAR_DESTINATIONS))) {
+        if (cfg.destinationCount < MAX_DESTINATIONS - 1 && ParseDestination(entry, cfg.destinations[cfg.destinationCount])) {
+            cfg.destinationCount++;
+        }
+    }
+    // Per-target counters describe the current table
+    const ConfigSnapshot& previous = g_config.current();
+    if (cfg.destinationCount != previous.destinationCount ||
+        memcmp(cfg.destinations, previous.destinations, cfg.destinationCount * sizeof(DestinationSpec)) != 0) {
+        for (int i = 1; i < MAX_DESTINATIONS; i++) {
+            ForwarderStats::Destination& stats = g_stats.destinations[i];
+            stats.datagrams.store(0, std::memory_order_relaxed);
+            stats.bytes.store(0, std::memory_order_relaxed);
+            stats.errors.store(0, std::memory_order_relaxed);
+        }
+    }
+    if (cfg.filter && filterKey != filterLoaded) {
+        LoadFilter(CvarValue(CVAR_FILTER_FILE));
+    }
+    filterLoaded = cfg.filter ? filterKey : "";
+    g_config.publish(cfg);
+    for (int lane = 0; lane < LANE_COUNT; lane++) {
+        g_sendQueue.configureLane(lane, cfg.laneBytes[lane], cfg.laneDropOldest[lane], cfg.laneWeights[lane]);
+    }
+    g_destination.update(cfg.serverIp, cfg.serverPort, cfg.destinations, cfg.destinationCount);
+    // Disabling cf_spool only unmaps it; the segments stay on disk for the next enable
+    if (!g_spool.configure(cfg.spool ? cfg.spoolPath : "", cfg.spoolBytes) && cfg.spool) {
+        g_engine.Con_Printf("[ChatForwarder] Cannot open spool directory %s\n", cfg.spoolPath);
+    }
+    published = true;
+
+    // The blocked reactor re-reads the snapshot (enable/disable, listen-only, protocol, ...)
+    g_sendQueue.wake();
+}
+
+// Trims one inbound command, strips the urgent prefix and queues it for HUD_Frame
+static void QueueCommand(const char* text, size_t len, const CommandRequest& request)
+{
+    // Trailing control characters and spaces, then leading whitespace
+    while (len > 0 && (unsigned char)text[len - 1] <= 32) {
+        len--;
+    }
+    while (len > 0 && (*text == ' ' || *text == '\t' || *text == '\n' || *text == '\r')) {
+        text++;
+        len--;
+    }
+    bool urgent = len > 0 && *text == URGENT_COMMAND_PREFIX;
+    if (urgent) {
+        do {
+            text++;
+            len--;
+        } while (len > 0 && (*text == ' ' || *text == '\t'));
+    }
+    if (len == 0) {
+        return;
+    }
+
+    ForwarderStats::Add(g_stats.commandsReceived);
+    ForwarderStats::Add(g_stats.commandBytes, len);
+    // The console would run a longer line cut off, which is worse than not at all
+    if (len >= MAX_COMMAND_SIZE || !g_messageQueue.push(text, len, urgent, MonotonicTicks(), request)) {
+        ForwarderStats::Add(g_stats.commandsDropped);
+    }
+}
+
+// A command, or [REQUEST_MAGIC][uint32 id] followed by a command whose output goes back
+// to the sender (see CommandScheduler); id 0 asks for no reply
+static void QueueRequest(const char* text, size_t len, const sockaddr_in& from)
+{
+    CommandRequest request;
+    if (len >= REQUEST_HEADER_SIZE && (unsigned char)text[0] == REQUEST_MAGIC) {
+        const unsigned char* id = reinterpret_cast<const unsigned char*>(text + 1);
+        request.id = id[0] | (uint32_t)id[1] << 8 | (uint32_t)id[2] << 16 | (uint32_t)id[3] << 24;
+        request.replyTo = from;
+        text += REQUEST_HEADER_SIZE;
+        len -= REQUEST_HEADER_SIZE;
+    }
+    QueueCommand(text, len, request);
+}
+
+// One command per line, or [COMMAND_BATCH_MAGIC] { [varint length][command] } ... for
+// commands that may contain anything; any single command may be a request
+static void QueueCommands(const char* data, size_t len, const sockaddr_in& from)
+{
+    if ((unsigned char)data[0] == REQUEST_MAGIC) {
+        QueueRequest(data, len, from);
+        return;
+    }
+    if ((unsigned char)data[0] != COMMAND_BATCH_MAGIC) {
+        for (const char* end = data + len; data < end; ) {
+            const char* newline = static_cast<const char*>(memchr(data, '\n', end - data));
+            const char* lineEnd = newline ? newline : end;
+            QueueCommand(data, lineEnd - data, CommandRequest());
+            data = lineEnd + 1;
+        }
+        return;
+    }
+    for (size_t pos = 1; pos < len; ) {
+        size_t commandLen = 0;
+        int shift = 0;
+        unsigned char byte;
+        do {
+            byte = pos < len ? (unsigned char)data[pos++] : 0;
+            commandLen |= (size_t)(byte & 0x7F) << shift;
+            shift += 7;
+        } while ((byte & 0x80) && shift < 28);
+        if (commandLen > len - pos) {
+            ForwarderStats::Add(g_stats.commandsDropped); // truncated batch: drop the rest
+            return;
+        }
+        QueueRequest(data + pos, commandLen, from);
+        pos += commandLen;
+    }
+}
+
+// Datagram budget left for protocol payload once the cf_reliable sequence header is in
+static size_t PayloadMtu(const ConfigSnapshot& cfg) {
+    return cfg.frameMtu - (cfg.reliable ? SEQUENCE_HEADER_SIZE : 0);
+}
+
+// One work item for all socket I/O. It blocks on the cf_listen_port socket and the send
+// queue's event together, so a record, a datagram, a config change, a reply or shutdown
+// wakes it, and the flush/stats/replay deadlines bound the wait. Events go out from a
+// socket of their own, so their source port does not change.
+bool ReactorWorkCallback(void* ctx) {
+    UdpSocket sock;
+    if (!sock.open()) {
+        return true;
+    }
+    // Without a listening socket the reactor still sends
+    UdpSocket listenSocket;
+    bool listening = listenSocket.open() && listenSocket.bind(g_config.current().listenPort) &&
+        listenSocket.watch();
+    if (!listening) {
+        listenSocket.close();
+    }
+
+    char packet[MAX_RECORD_SIZE];
+    size_t packetLen = 0;
+    ResolvedDestination dest;
+    FrameBuilder frame;
+    Fragmenter fragmenter;
+    // cf_reliable: sequence numbers restart for each new destination
+    RetransmitRing retransmit;
+    std::vector<NackQueue::Range> nacked;
+    uint32_t nextSeq = 1;
+    uint32_t seqGeneration = 0;
+    auto frameDeadline = std::chrono::steady_clock::now();
+    auto statsDeadline = std::chrono::steady_clock::now();
+    // Records and body bytes per lane in the pending frame, credited once it is sent
+    uint64_t frameRecords[LANE_COUNT] = {}, frameBytes[LANE_COUNT] = {};
+    // Enqueue stamp of the record in packet
+    int64_t enqueued = 0;
+#if CF_PROFILER
+    int64_t dequeued = 0;
+    struct FrameStamp {
+        int lane;
+        int64_t enqueued;
+        int64_t dequeued;
+    };
+    std::vector<FrameStamp> frameStamps;
+    auto recordSent = [&](int lane, int64_t enqueuedAt, int64_t dequeuedAt, int64_t sentAt) {
+        g_profiler.recordOutbound(LatencyProfiler::STAGE_SEND, lane, dequeuedAt, sentAt);
+        g_profiler.recordOutbound(LatencyProfiler::STAGE_TOTAL, lane, enqueuedAt, sentAt);
+    };
+#endif
+    auto stampDequeued = [&]() {
+#if CF_PROFILER
+        dequeued = ProfileNow();
+        g_profiler.recordOutbound(LatencyProfiler::STAGE_QUEUE, SendQueue::LaneOf(packet[0]), enqueued, dequeued);
+#endif
+    };
+
+    auto sendDatagram = [&](const char* data, size_t len, DropReason& reason) {
+        // If the destination does not resolve (e.g. cvar not yet set), drop the datagram
+        if (!g_destination.refresh(dest)) {
+            reason = DROP_NO_ROUTE;
+            return false;
+        }
+        const ConfigSnapshot& cfg = g_config.current();
+        if (cfg.reliable) {
+            if (seqGeneration != dest.generation || retransmit.capacity() != cfg.retransmitBytes) {
+                if (seqGeneration != dest.generation) {
+                    nextSeq = 1;
+                    seqGeneration = dest.generation;
+                }
+                retransmit.reset(cfg.retransmitBytes);
+            }
+            // Sequenced in place: the ring copy is what goes on the wire
+            uint32_t seq = nextSeq++;
+            char* out = retransmit.append(seq, SEQUENCE_HEADER_SIZE + len);
+            if (out) {
+                out[0] = (char)SEQUENCE_MAGIC;
+                for (int i = 0; i < 4; i++) {
+                    out[1 + i] = (char)(seq >> (8 * i));
+                }
+                memcpy(out + SEQUENCE_HEADER_SIZE, data, len);
+                data = out;
+                len += SEQUENCE_HEADER_SIZE;
+            }
+            g_stats.lastSequence.store(seq, std::memory_order_relaxed);
+        }
+        if (!sock.sendTo(data, len, dest.addr)) {
+            ForwarderStats::Add(g_stats.sendErrors);
+            ForwarderStats::Add(g_stats.destinations[0].errors);
+            reason = DROP_SEND_ERROR;
+            return false;
+        }
+        ForwarderStats::Add(g_stats.datagrams);
+        ForwarderStats::Add(g_stats.datagramBytes, len);
+        ForwarderStats::Add(g_stats.destinations[0].datagrams);
+        ForwarderStats::Add(g_stats.destinations[0].bytes, len);
+        return true;
+    };
+    // cf_destinations get the same bytes, unsequenced: every target whose tag mask covers tags,
+    // or (exact) whose mask is tags. Call after sendDatagram, which refreshes the table.
+    auto fanOut = [&](const char* data, size_t len, int tags, bool exact) {
+        for (int i = 0; i < dest.extraCount; i++) {
+            const ResolvedDestination::Extra& extra = dest.extras[i];
+            if (!extra.valid || (exact ? extra.tags != tags : (extra.tags & tags) != tags)) {
+                continue;
+            }
+            ForwarderStats::Destination& stats = g_stats.destinations[1 + i];
+            if (sock.sendTo(data, len, extra.addr)) {
+                ForwarderStats::Add(stats.datagrams);
+                ForwarderStats::Add(stats.bytes, len);
+            }
+            else {
+                ForwarderStats::Add(stats.errors);
+            }
+        }
+    };
+    // Resends NACKed datagrams from the ring, byte for byte, with their original sequence numbers
+    auto retransmitNacked = [&]() {
+        g_nacks.take(nacked);
+        uint32_t budget = RETRANSMIT_BATCH;
+        for (const NackQueue::Range& range : nacked) {
+            for (uint32_t i = 0; i < range.length && budget > 0; i++, budget--) {
+                size_t len;
+                const char* data = retransmit.find(range.first + i, len);
+                if (!data || !dest.valid) {
+                    ForwarderStats::Add(g_stats.retransmitMissed);
+                    continue;
+                }
+                if (sock.sendTo(data, len, dest.addr)) {
+                    ForwarderStats::Add(g_stats.retransmitted);
+                    ForwarderStats::Add(g_stats.datagrams);
+                    ForwarderStats::Add(g_stats.datagramBytes, len);
+                    ForwarderStats::Add(g_stats.destinations[0].datagrams);
+                    ForwarderStats::Add(g_stats.destinations[0].bytes, len);
+                }
+                else {
+                    ForwarderStats::Add(g_stats.sendErrors);
+                    ForwarderStats::Add(g_stats.destinations[0].errors);
+                }
+            }
+        }
+        nacked.clear();
+    };
+    auto account = [&](int lane, uint64_t records, uint64_t bytes, bool sent, DropReason reason) {
+        ForwarderStats::Lane& stats = g_stats.lanes[lane];
+        if (sent) {
+            ForwarderStats::Add(stats.sent, records);
+            ForwarderStats::Add(stats.sentBytes, bytes);
+        }
+        else {
+            ForwarderStats::Add(stats.dropped[reason], records);
+        }
+    };
+    // cf_spool: what cf_server_ip did not get is kept for a replay. Replays go to cf_server_ip
+    // only; the cf_destinations targets had their copy already.
+    bool replaying = false;
+    auto spoolUndelivered = [&](char tag, const char* body, size_t bodyLen) {
+        if (g_config.current().spool && g_spool.append(tag, body, bodyLen)) {
+            ForwarderStats::Add(g_stats.spooled);
+        }
+    };
+    // v1: one datagram per record, or one per fragment if the record exceeds cf_frame_mtu
+    auto sendRecord = [&](const char* record, size_t len) {
+        DropReason reason = DROP_NO_ROUTE;
+        bool sent;
+        int lane = SendQueue::LaneOf(record[0]);
+        size_t mtu = PayloadMtu(g_config.current());
+        if (len <= mtu) {
+            sent = sendDatagram(record, len, reason);
+            if (!replaying) {
+                fanOut(record, len, 1 << lane, false);
+            }
+        }
+        else {
+            fragmenter.begin(record, len, mtu - 1 - FRAGMENT_HEADER_SIZE);
+            ForwarderStats::Add(g_stats.fragments, fragmenter.count());
+            const char* piece;
+            size_t pieceLen;
+            sent = true;
+            while (fragmenter.next(piece, pieceLen)) {
+                if (sent) {
+                    sent = sendDatagram(piece, pieceLen, reason);
+                }
+                else if (replaying) {
+                    break;
+                }
+                if (!replaying) {
+                    fanOut(piece, pieceLen, 1 << lane, false);
+                }
+            }
+        }
+        account(lane, 1, len - 1, sent, reason);
+        if (!sent && !replaying) {
+            spoolUndelivered(record[0], record + 1, len - 1);
+        }
+#if CF_PROFILER
+        if (sent) {
+            recordSent(lane, enqueued, dequeued, ProfileNow());
+        }
+#endif
+        return sent;
+    };
+    // v2 frames for cf_destinations targets with a partial tag mask, one per distinct mask.
+    // Targets with every tag share the cf_server_ip frame. All of them flush together.
+    struct GroupFrame {
+        int tags;
+        FrameBuilder frame;
+    };
+    std::vector<std::unique_ptr<GroupFrame>> groups;
+    uint32_t groupsGeneration = 0;
+    bool frameReplayed = false;  // the pending frame holds spool replays, for cf_server_ip only
+    // Fragmented events with a piece in the pending frame. The spool gets them whole if any
+    // frame that carried a piece fails; the last one is still being fragmented if fragmenting.
+    struct FramedEvent {
+        std::string record;
+        bool failed;
+    };
+    std::vector<FramedEvent> frameEvents;
+    bool fragmenting = false;
+    auto flushGroup = [&](GroupFrame& group) {
+        if (!group.frame.empty()) {
+            fanOut(group.frame.data(), group.frame.size(), group.tags, true);
+        }
+        group.frame.reset(frame.mtu());
+    };
+    auto syncGroups = [&]() {
+        if (groupsGeneration == dest.generation) {
+            return;
+        }
+        for (auto& group : groups) {
+            flushGroup(*group);
+        }
+        groups.clear();
+        for (int i = 0; i < dest.extraCount; i++) {
+            int tags = dest.extras[i].tags;
+            if (tags != ALL_TAGS && std::none_of(groups.begin(), groups.end(),
+                [tags](const std::unique_ptr<GroupFrame>& group) { return group->tags == tags; })) {
+                groups.emplace_back(new GroupFrame);
+                groups.back()->tags = tags;
+                groups.back()->frame.reset(frame.mtu());
+            }
+        }
+        groupsGeneration = dest.generation;
+    };
+    auto flushFrame = [&]() {
+        if (!frame.empty()) {
+            DropReason reason = DROP_NO_ROUTE;
+            bool sent = sendDatagram(frame.data(), frame.size(), reason);
+            if (!frameReplayed) {
+                fanOut(frame.data(), frame.size(), ALL_TAGS, true);
+            }
+            for (int lane = 0; lane < LANE_COUNT; lane++) {
+                if (frameRecords[lane]) {
+                    account(lane, frameRecords[lane], frameBytes[lane], sent, reason);
+                }
+                frameRecords[lane] = frameBytes[lane] = 0;
+            }
+            // Spooled in frame order; a fragmented event takes the place of its last piece
+            size_t finished = frameEvents.size() - (fragmenting ? 1 : 0);
+            if (!sent || std::any_of(frameEvents.begin(), frameEvents.begin() + finished,
+                [](const FramedEvent& event) { return event.failed; })) {
+                size_t next = 0;
+                frame.forEach([&](char tag, const char* body, size_t bodyLen) {
+                    if (tag != MSG_TYPE_FRAGMENT) {
+                        if (!sent) {
+                            spoolUndelivered(tag, body, bodyLen);
+                        }
+                    }
+                    else if ((unsigned char)body[3] + 1 == (unsigned char)body[4] && next < finished) {
+                        const FramedEvent& event = frameEvents[next++];
+                        if (!sent || event.failed) {
+                            spoolUndelivered(event.record[0], event.record.data() + 1, event.record.size() - 1);
+                        }
+                    }
+                });
+            }
+            if (!sent && fragmenting) {
+                frameEvents.back().failed = true;
+            }
+            frameEvents.erase(frameEvents.begin(), frameEvents.begin() + finished);
+#if CF_PROFILER
+            if (sent) {
+                int64_t sentAt = ProfileNow();
+                for (const FrameStamp& stamp : frameStamps) {
+                    recordSent(stamp.lane, stamp.enqueued, stamp.dequeued, sentAt);
+                }
+            }
+            frameStamps.clear();
+#endif
+        }
+        frame.reset(PayloadMtu(g_config.current()));
+        for (auto& group : groups) {
+            flushGroup(*group);
+        }
+    };
+    // complete is false for all but the last fragment of an event; bodyBytes excludes fragment headers
+    auto appendRecord = [&](const char* record, size_t len, int lane, bool complete, size_t bodyBytes) {
+        if (!frame.append(record[0], record + 1, len - 1)) {
+            return false;
+        }
+        frameBytes[lane] += bodyBytes;
+        if (complete) {
+            frameRecords[lane]++;
+#if CF_PROFILER
+            frameStamps.push_back(FrameStamp{ lane, enqueued, dequeued });
+#endif
+        }
+        return true;
+    };
+    auto addToFrame = [&](const char* record, size_t len, int lane, bool complete, size_t bodyBytes) {
+        if (!frame.empty() && !appendRecord(record, len, lane, complete, bodyBytes)) {
+            flushFrame();
+        }
+        if (frame.empty()) {
+            frameDeadline = std::chrono::steady_clock::now() + std::chrono::microseconds(g_config.current().flushUs);
+            appendRecord(record, len, lane, complete, bodyBytes);
+        }
+        if (frameReplayed) {
+            return;
+        }
+        syncGroups();
+        for (auto& group : groups) {
+            if ((group->tags & (1 << lane)) && !group->frame.append(record[0], record + 1, len - 1)) {
+                flushGroup(*group);
+                group->frame.append(record[0], record + 1, len - 1);
+            }
+        }
+    };
+    // v2: a record no frame could hold goes in as fragments, each filling at most one frame
+    auto frameRecord = [&](const char* record, size_t len) {
+        if (frame.mtu() != PayloadMtu(g_config.current())) {
+            flushFrame(); // cf_frame_mtu changed: pieces must fit the frames they go into
+        }
+        if (!frame.empty() && frameReplayed != replaying) {
+            flushFrame(); // replays and live records never share a frame
+        }
+        frameReplayed = replaying;
+        int lane = SendQueue::LaneOf(record[0]);
+        if (frame.fits(len - 1)) {
+            addToFrame(record, len, lane, true, len - 1);
+            return;
+        }
+        fragmenter.begin(record, len, frame.mtu() - PROTOCOL_V2_HEADER_SIZE - 4 - FRAGMENT_HEADER_SIZE);
+        ForwarderStats::Add(g_stats.fragments, fragmenter.count());
+        const char* piece;
+        size_t pieceLen;
+        while (fragmenter.next(piece, pieceLen)) {
+            addToFrame(piece, pieceLen, lane, fragmenter.done(), pieceLen - 1 - FRAGMENT_HEADER_SIZE);
+            if (!fragmenting) {
+                frameEvents.push_back(FramedEvent{ std::string(record, len), false });
+                fragmenting = true;
+            }
+        }
+        fragmenting = false;
+    };
+    // The stats report bypasses the lanes and goes out as a datagram of its own
+    auto sendStats = [&](const ConfigSnapshot& cfg) {
+        packet[0] = MSG_TYPE_STATS;
+        size_t len = 1 + g_stats.format(packet + 1, MAX_STATS_REPORT);
+        DropReason reason;
+        if (cfg.protocol < 2) {
+            sendDatagram(packet, len, reason);
+            return;
+        }
+        flushFrame();
+        frame.append(packet[0], packet + 1, len - 1);
+        sendDatagram(frame.data(), frame.size(), reason);
+        frame.reset(PayloadMtu(cfg));
+    };
+    // Replays spooled records through the normal v1/v2 path, to cf_server_ip only. A v1 send
+    // that fails leaves the record at the head of the spool; v2 records are consumed once
+    // framed, and a frame that fails to go out is spooled again by flushFrame.
+    double replayTokens = 0.0;
+    auto replayRefill = std::chrono::steady_clock::now();
+    bool replayArmed = false;
+    auto replaySpool = [&](const ConfigSnapshot& cfg, int budget) {
+        for (; budget > 0 && g_spool.peek(packet, sizeof(packet), packetLen); budget--) {
+#if CF_PROFILER
+            enqueued = dequeued = ProfileNow();
+#endif
+            replaying = true;
+            bool sent = true;
+            if (cfg.protocol < 2) {
+                sent = sendRecord(packet, packetLen);
+            }
+            else {
+                frameRecord(packet, packetLen);
+            }
+            replaying = false;
+            if (!sent) {
+                return false;
+            }
+            g_spool.consume();
+            ForwarderStats::Add(g_stats.spoolReplayed);
+        }
+        return true;
+    };
+
+    static_assert(NACK_HEADER_SIZE + 255 * NACK_RANGE_SIZE <= MAX_COMMAND_DATAGRAM, "a full NACK must fit");
+    char buffer[MAX_COMMAND_DATAGRAM];
+    std::vector<ReplyQueue::Reply> replies;
+    // Set when the socket may hold datagrams: a wait said so, a read pass stopped at
+    // REACTOR_BATCH, or REACTOR_BATCH records went out without a wait in between
+    bool inboundDue = listening;
+    int busyRecords = 0;
+    auto stopListening = [&]() {
+        listenSocket.close();
+        listening = false;
+        inboundDue = false;
+    };
+    // Reads up to REACTOR_BATCH datagrams: NACKs for the send path, everything else commands
+    auto receive = [&]() {
+        inboundDue = false;
+        busyRecords = 0;
+        for (int i = 0; i < REACTOR_BATCH; i++) {
+            size_t bytesRead = 0;
+            sockaddr_in from = {};
+            SocketRecv status = listenSocket.recv(buffer, sizeof(buffer), bytesRead, &from);
+            if (status == RECV_WOULD_BLOCK) {
+                return;
+            }
+            if (status == RECV_ERROR) {
+                stopListening();
+                return;
+            }
+            if (status == RECV_SKIPPED || bytesRead == 0) {
+                continue;
+            }
+            // cf_reliable receiver feedback, never a console command
+            if ((unsigned char)buffer[0] == SEQUENCE_MAGIC) {
+                if (g_config.current().reliable && g_nacks.parse(buffer, bytesRead)) {
+                    ForwarderStats::Add(g_stats.nacks);
+                }
+                continue;
+            }
+            QueueCommands(buffer, bytesRead, from);
+        }
+        inboundDue = true;
+    };
+    // Command replies come back from the listening socket
+    auto sendReplies = [&]() {
+        g_replies.take(replies);
+        for (const ReplyQueue::Reply& reply : replies) {
+            if (listening) {
+                listenSocket.sendTo(reply.datagram.data(), reply.datagram.size(), reply.to);
+            }
+        }
+        replies.clear();
+    };
+    // records: a new record or capture ends the wait too; inbound: so does a datagram
+    auto wait = [&](int timeoutMs, bool records, bool inbound) {
+        SocketWait result = g_sendQueue.wait(listening && inbound ? &listenSocket : nullptr, timeoutMs, records);
+        ForwarderStats::Add(g_stats.reactorWakeups);
+        if (result == SOCKET_READABLE) {
+            inboundDue = true;
+        }
+        else if (result == SOCKET_WAIT_FAILED) {
+            stopListening();
+        }
+    };
+    // Records sent since the socket was last read; past REACTOR_BATCH inbound gets a turn
+    auto sentWithoutWait = [&](int records) {
+        busyRecords += records;
+        if (listening && busyRecords >= REACTOR_BATCH) {
+            inboundDue = true;
+        }
+    };
+    flushFrame();
+
+    while (!g_shutdownReactor.load(std::memory_order_relaxed)) {
+        const ConfigSnapshot& cfg = g_config.current();
+
+        // Disabled: nothing is sent or received until the config changes
+        if (!cfg.enabled) {
+            wait(-1, false, false);
+            continue;
+        }
+
+        if (inboundDue) {
+            receive();
+        }
+        if (g_replies.pending()) {
+            sendReplies();
+        }
+
+        // Listen-only: commands in, nothing out
+        if (cfg.listenOnly) {
+            wait(inboundDue ? 0 : -1, false, true);
+            continue;
+        }
+
+        if (g_nacks.pending()) {
+            retransmitNacked();
+        }
+
+        // cf_deferred: decode what the hooks captured into the lanes before sending
+        Forwarder_DecodeCaptures();
+
+        // Periodic stats report; caps how long the sender may block below
+        int waitMs = -1;
+        if (cfg.statsInterval > 0.0) {
+            auto now = std::chrono::steady_clock::now();
+            auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(cfg.statsInterval));
+            if (statsDeadline > now + interval) {
+                statsDeadline = now + interval; // interval was shortened
+            }
+            if (now >= statsDeadline) {
+                sendStats(cfg);
+                statsDeadline = now + interval;
+                continue;
+            }
+            waitMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                statsDeadline - now + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1)).count();
+        }
+
+        // cf_spool: replay at cf_spool_rate while the lanes are idle and the destination resolves.
+        // cf_spool_auto 0 waits for cf_spool_replay, which arms one replay until the spool is empty.
+        if (g_spool.takeReplayRequest()) {
+            replayArmed = true;
+        }
+        if (!cfg.spool || g_spool.empty()) {
+            replayArmed = false;
+        }
+        else if (cfg.spoolAuto || replayArmed) {
+            auto now = std::chrono::steady_clock::now();
+            double burst = (std::min)((std::max)(cfg.spoolRate, 1.0), (double)SPOOL_REPLAY_BATCH);
+            replayTokens = cfg.spoolRate <= 0.0 ? (double)SPOOL_REPLAY_BATCH : (std::min)(burst,
+                replayTokens + std::chrono::duration<double>(now - replayRefill).count() * cfg.spoolRate);
+            replayRefill = now;
+
+            int replayWaitMs;
+            if (!g_sendQueue.idle()) {
+                replayWaitMs = 0;  // live records first; the lanes are drained below
+            }
+            else if (!g_destination.refresh(dest)) {
+                replayWaitMs = DESTINATION_RETRY_MS;
+            }
+            else if (replayTokens < 1.0) {
+                replayWaitMs = (int)std::ceil((1.0 - replayTokens) * 1000.0 / cfg.spoolRate);
+            }
+            else {
+                int budget = (int)replayTokens;
+                uint64_t before = ForwarderStats::Get(g_stats.spoolReplayed);
+                bool delivered = replaySpool(cfg, budget);
+                uint64_t replayed = ForwarderStats::Get(g_stats.spoolReplayed) - before;
+                replayTokens -= (double)replayed;
+                sentWithoutWait((int)replayed);
+                // A failed v1 send ends the pass; the destination is retried like an unresolved one
+                replayWaitMs = delivered ? 0 : DESTINATION_RETRY_MS;
+            }
+            if (replayWaitMs > 0) {
+                waitMs = waitMs < 0 ? replayWaitMs : (std::min)(waitMs, replayWaitMs);
+            }
+            else if (g_sendQueue.idle()) {
+                continue; // more to replay, nothing live to send
+            }
+        }
+
+        if (cfg.protocol < 2) {
+            if (!frame.empty()) {
+                flushFrame(); // switched back to v1 with a frame pending
+            }
+            // Send up to a batch, then let inbound and the timers have their turn
+            int sent = 0;
+            while (sent < REACTOR_BATCH && g_sendQueue.pop(packet, sizeof(packet), packetLen, &enqueued)) {
+                stampDequeued();
+                sendRecord(packet, packetLen);
+                sent++;
+            }
+            if (sent) {
+                sentWithoutWait(sent);
+            }
+            else if (!inboundDue) {
+                wait(waitMs, true, true);
+            }
+            continue;
+        }
+
+        // Framed mode: coalesce records until the frame is full or its deadline passes
+        if (!frame.empty()) {
+            auto remaining = frameDeadline - std::chrono::steady_clock::now();
+            if (remaining <= std::chrono::steady_clock::duration::zero()) {
+                flushFrame();
+                continue;
+            }
+            // Round up so we never wake before the deadline
+            int frameWaitMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                remaining + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1)).count();
+            waitMs = waitMs < 0 ? frameWaitMs : (std::min)(waitMs, frameWaitMs);
+        }
+
+        if (g_sendQueue.pop(packet, sizeof(packet), packetLen, &enqueued)) {
+            stampDequeued();
+            frameRecord(packet, packetLen);
+            if (std::chrono::steady_clock::now() >= frameDeadline) {
+                flushFrame();
+            }
+            sentWithoutWait(1);
+        }
+        else if (!inboundDue) {
+            wait(waitMs, true, true);
+        }
+    }
+
+    flushFrame();
+    return true;
+}
+
+void Cmd_DedupStats(void)
+{
+    g_engine.Con_Printf("[ChatForwarder] Dedup dropped %u duplicate(s)\n", (unsigned)g_dedup.hits());
+}
+
+size_t ForwarderStats::format(char* out, size_t size) const
+{
+    static const char* const laneNames[LANE_COUNT] = { "CHAT", "GAME", "NET", "SYS", "STUFF" };
+    size_t len = 0;
+    auto append = [&](const char* fmt, ...) {
+        if (len + 1 >= size) {
+            return;
+        }
+        va_list args;
+        va_start(args, fmt);
+        int written = vsnprintf(out + len, size - len, fmt, args);
+        va_end(args);
+        if (written > 0) {
+            len = (std::min)(len + (size_t)written, size - 1);
+        }
+    };
+
+    for (int lane = 0; lane < LANE_COUNT; lane++) {
+        const Lane& stats = lanes[lane];
+        const RecordRing& ring = g_sendQueue.lane(lane);
+        append("%s enq=%llu/%lluB sent=%llu/%lluB full=%llu evict=%llu filt=%llu dup=%llu noroute=%llu senderr=%llu "
+            "depth=%uB hw=%uB\n", laneNames[lane],
+            Get(stats.enqueued), Get(stats.enqueuedBytes), Get(stats.sent), Get(stats.sentBytes),
+            (unsigned long long)ring.overflowed(), (unsigned long long)ring.evicted(), Get(stats.dropped[DROP_FILTERED]),
+            Get(stats.dropped[DROP_DUPLICATE]),
+            Get(stats.dropped[DROP_NO_ROUTE]), Get(stats.dropped[DROP_SEND_ERROR]),
+            (unsigned)ring.sizeBytes(), ring.highWater());
+    }
+    const RecordRing& capture = g_sendQueue.captureRing();
+    append("CAPTURE enq=%llu full=%llu depth=%uB hw=%uB\n",
+        Get(captured), (unsigned long long)capture.overflowed(), (unsigned)capture.sizeBytes(), capture.highWater());
+    append("OUT datagrams=%llu/%lluB senderr=%llu frag=%llu seq=%u ack=%u nack=%llu resent=%llu miss=%llu\n",
+        Get(datagrams), Get(datagramBytes), Get(sendErrors), Get(fragments),
+        lastSequence.load(std::memory_order_relaxed), g_nacks.ack(), Get(nacks), Get(retransmitted),
+        Get(retransmitMissed));
+    append("SPOOL in=%llu out=%llu lost=%llu depth=%lluB\n",
+        Get(spooled), Get(spoolReplayed), (unsigned long long)g_spool.lost(),
+        (unsigned long long)g_spool.pendingBytes());
+    append("IN recv=%llu/%lluB full=%llu exec=%llu depth=%u hw=%u\n",
+        Get(commandsReceived), Get(commandBytes), Get(commandsDropped), Get(commandsExecuted),
+        (unsigned)g_messageQueue.size(), commandHighWater.load(std::memory_order_relaxed));
+    return len;
+}
+
+void Cmd_Stats(void)
+{
+    char report[MAX_STATS_REPORT];
+    g_stats.format(report, sizeof(report));
+    // Con_Printf has a small internal buffer; print one line at a time
+    for (char* line = report; *line; ) {
+        char* end = strchr(line, '\n');
+        if (end) {
+            *end = '\0';
+        }
+        g_engine.Con_Printf("[ChatForwarder] %s\n", line);
+        if (!end) {
+            break;
+        }
+        line = end + 1;
+    }
+}
+
+#if CF_PROFILER
+static void PrintLatency(const char* name, const LatencyHistogram& histogram)
+{
+    if (histogram.count() == 0) {
+        return;
+    }
+    g_engine.Con_Printf("[ChatForwarder] %-12s n=%-8llu p50=%.1fus p99=%.1fus max=%.1fus\n", name,
+        (unsigned long long)histogram.count(), histogram.percentile(0.50) / 1000.0,
+        histogram.percentile(0.99) / 1000.0, histogram.max() / 1000.0);
+}
+#endif
+
+void Cmd_Latency(void)
+{
+#if CF_PROFILER
+    if (g_engine.Cmd_Argc() > 1 && !strcmp(g_engine.Cmd_Argv(1), "reset")) {
+        g_profiler.reset();
+        g_engine.Con_Printf("[ChatForwarder] Latency histograms reset\n");
+        return;
+    }
+    static const char* const laneNames[LANE_COUNT] = { "CHAT", "GAME", "NET", "SYS", "STUFF" };
+    static const char* const stageNames[LatencyProfiler::STAGE_COUNT] = { "hook", "queue", "send", "total" };
+    for (int stage = 0; stage < LatencyProfiler::STAGE_COUNT; stage++) {
+        for (int lane = 0; lane < LANE_COUNT; lane++) {
+            char name[32];
+            snprintf(name, sizeof(name), "%s %s", laneNames[lane], stageNames[stage]);
+            PrintLatency(name, g_profiler.outbound[stage][lane]);
+        }
+    }
+    PrintLatency("CMD wait", g_profiler.commandWait);
+    PrintLatency("frame hooks", g_profiler.frameHooks);
+    g_engine.Con_Printf("[ChatForwarder] Hooks took %.1fus last frame\n", g_profiler.lastFrameHookNs() / 1000.0);
+#else
+    g_engine.Con_Printf("[ChatForwarder] Latency profiler not compiled in (CF_PROFILER=0)\n");
+#endif
+}
+
+// Also works as an inbound command: a receiver coming back up asks for what it missed
+void Cmd_SpoolReplay(void)
+{
+    g_spool.requestReplay();
+    g_sendQueue.wake();
+    g_engine.Con_Printf("[ChatForwarder] Replaying %llu spooled byte(s)\n",
+        (unsigned long long)g_spool.pendingBytes());
+}
+
+// Rewrites cf_destinations (archived like every cvar) and applies it right away
+static void SetDestinations(const std::vector<std::string>& entries)
+{
+    std::string value;
+    for (const std::string& entry : entries) {
+        value += value.empty() ? "" : " ";
+        value += entry;
+    }
+    if (g_engine.CvarSet) {
+        g_engine.CvarSet(CVAR_DESTINATIONS, value.c_str());
+        RefreshConfig();
+    }
+}
+
+static std::string AddressOf(const std::string& entry)
+{
+    return entry.substr(0, entry.find('/'));
+}
+
+// cf_dest_add <host:port> [tags]: adds a target, or changes the tags of an existing one
+void Cmd_DestAdd(void)
+{
+    if (g_engine.Cmd_Argc() < 2) {
+        g_engine.Con_Printf("[ChatForwarder] Usage: cf_dest_add <host:port> [tags]\n");
+        return;
+    }
+    std::string entry = g_engine.Cmd_Argv(1);
+    if (g_engine.Cmd_Argc() > 2) {
+        entry = AddressOf(entry) + "/" + g_engine.Cmd_Argv(2);
+    }
+    DestinationSpec spec;
+    if (!ParseDestination(entry, spec)) {
+        g_engine.Con_Printf("[ChatForwarder] Invalid destination %s\n", entry.c_str());
+        return;
+    }
+    std::vector<std::string> entries = DestinationEntries(CvarValue(CVAR_DESTINATIONS));
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+        [&entry](const std::string& existing) { return AddressOf(existing) == AddressOf(entry); }), entries.end());
+    if (entries.size() >= MAX_DESTINATIONS - 1) {
+        g_engine.Con_Printf("[ChatForwarder] At most %d destinations besides cf_server_ip\n", MAX_DESTINATIONS - 1);
+        return;
+    }
+    entries.push_back(entry);
+    SetDestinations(entries);
+}
+
+// cf_dest_remove <host:port>
+void Cmd_DestRemove(void)
+{
+    if (g_engine.Cmd_Argc() < 2) {
+        g_engine.Con_Printf("[ChatForwarder] Usage: cf_dest_remove <host:port>\n");
+        return;
+    }
+    std::string address = AddressOf(g_engine.Cmd_Argv(1));
+    std::vector<std::string> entries = DestinationEntries(CvarValue(CVAR_DESTINATIONS));
+    size_t count = entries.size();
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+        [&address](const std::string& existing) { return AddressOf(existing) == address; }), entries.end());
+    if (entries.size() == count) {
+        g_engine.Con_Printf("[ChatForwarder] No destination %s\n", address.c_str());
+        return;
+    }
+    SetDestinations(entries);
+}
+
+void Cmd_DestList(void)
+{
+    const ConfigSnapshot& cfg = g_config.current();
+    auto print = [](int index, const char* host, const char* port, int tags) {
+        const ForwarderStats::Destination& stats = g_stats.destinations[index];
+        g_engine.Con_Printf("[ChatForwarder] #%d %s:%s tags=%d datagrams=%llu/%lluB errors=%llu\n",
+            index, host, port, tags, ForwarderStats::Get(stats.datagrams), ForwarderStats::Get(stats.bytes),
+            ForwarderStats::Get(stats.errors));
+    };
+    print(0, cfg.serverIp, cfg.serverPort, ALL_TAGS);
+    for (int i = 0; i < cfg.destinationCount; i++) {
+        char port[16];
+        snprintf(port, sizeof(port), "%d", cfg.destinations[i].port);
+        print(1 + i, cfg.destinations[i].host, port, cfg.destinations[i].tags);
+    }
+}
+
+void Cmd_FilterReload(void)
+{
+    LoadFilter(CvarValue(CVAR_FILTER_FILE));
+}
+
+void Cmd_FilterStats(void)
+{
+    const FilterSet* filter = g_filters.current();
+    if (!filter) {
+        g_engine.Con_Printf("[ChatForwarder] No filter rules loaded\n");
+        return;
+    }
+    g_engine.Con_Printf("[ChatForwarder] %u filter rule(s)%s\n", (unsigned)filter->size(),
+        g_config.current().filter ? "" : ", cf_filter is off");
+    for (size_t i = 0; i < filter->size(); i++) {
+        const FilterSet::Rule& rule = filter->rule(i);
+        g_engine.Con_Printf("[ChatForwarder] #%u tags=%d %c %s hits=%llu\n", (unsigned)i, rule.tags,
+            rule.exclude ? '-' : '+', rule.pattern.c_str(),
+            (unsigned long long)rule.hits.load(std::memory_order_relaxed));
+    }
+}
+
+void Cmd_CommandStats(void)
+{
+    g_engine.Con_Printf("[ChatForwarder] Commands: %u queued, %u executed, %d last frame, "
+        "%lld us last frame, %lld us max, %.2f tokens, %u replies\n",
+        (unsigned)g_messageQueue.size(), (unsigned)g_commandScheduler.executed(),
+        g_commandScheduler.lastFrameCommands(), g_commandScheduler.lastFrameUs(),
+        g_commandScheduler.maxFrameUs(), g_commandScheduler.tokens(),
+        (unsigned)g_commandScheduler.replies());
+}
+
+bool Forwarder_Init(void)
+{
+    // The outbound lanes are allocated once; cf_lane_bytes only moves the budgets inside them
+    if (!g_sendQueue.init(LANE_RING_BYTES)) {
+        return false;
+    }
+    RefreshConfig();
+    return true;
+}
+
+void Forwarder_Shutdown(void)
+{
+    // Signal the reactor to stop; shutdown() also wakes it from its blocking wait
+    g_shutdownReactor.store(true, std::memory_order_release);
+    g_sendQueue.shutdown();
+    g_messageQueue.shutdown();
+    g_destination.stop();
+}
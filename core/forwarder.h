@@ -0,0 +1,1777 @@
+// forwarder.h
+// Platform-neutral ChatForwarder core: queues, config, hook bodies and the I/O reactor
+// loop. It talks to the OS only through platform.h and to the game only through engine.h.
+#ifndef CF_FORWARDER_H
+#define CF_FORWARDER_H
+
+#include "platform.h"
+#include "engine.h"
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+// Latency/hook-cost profiler (cf_latency). Build with CF_PROFILER=0 to compile it out
+// entirely: no timestamps are taken and queued records carry no stamp.
+#ifndef CF_PROFILER
+#define CF_PROFILER 1
+#endif
+#if CF_PROFILER && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CF_HAVE_SSE2 1
+#include <emmintrin.h>
+#else
+#define CF_HAVE_SSE2 0
+#endif
+// AVX2 intrinsics compile without /arch:AVX2 on MSVC; only the _AVX2 build dispatches to them
+#if defined(_MSC_VER) || defined(__AVX2__)
+#define CF_HAVE_AVX2 1
+#include <immintrin.h>
+#else
+#define CF_HAVE_AVX2 0
+#endif
+
+constexpr size_t MAX_COMMAND_SIZE = 1024;         // Cbuf_Execute's line buffer: the longest command line, newline included
+constexpr size_t MAX_COMMAND_DATAGRAM = 8192;     // one datagram holds at most a full engine command buffer
+constexpr size_t COMMAND_RING_BYTES = 128 * 1024; // per inbound lane (urgent, normal); power of two
+constexpr unsigned char COMMAND_BATCH_MAGIC = 0xCD; // [magic] { [varint length][command] } ...
+// Command requests: [magic][uint32 LE id][command]. The requester gets one reply datagram,
+// [magic][uint32 LE id][flags][uint32 LE wait us][uint32 LE run us][captured output]
+constexpr unsigned char REQUEST_MAGIC = 0xCC;
+constexpr size_t REQUEST_HEADER_SIZE = 5;
+constexpr size_t REPLY_HEADER_SIZE = 14;
+constexpr size_t MAX_REPLY_SIZE = 8192;
+constexpr unsigned char REPLY_TRUNCATED = 0x01;   // flags: output did not fit MAX_REPLY_SIZE
+constexpr size_t MAX_PENDING_REPLIES = 64;        // built but not sent yet; more are dropped
+constexpr long COMMAND_REPLY_MAX_MS = 2000;       // a request's output window closes by then even if output keeps coming
+constexpr size_t MAX_QUEUE_SIZE = 1000;
+constexpr size_t MAX_MESSAGE_STRING = 8192;        // longest print/stufftext string we forward
+constexpr size_t MAX_USERMSG_SIZE = 8192;          // SayText/TextMsg bytes we parse; the rest is cut off
+constexpr int MAX_MESSAGE_ARGS = 4;                // %s arguments after the format string
+constexpr size_t SYS_LINE_FLUSH = 4096;            // unterminated OutputDebugString text flushed at this size
+constexpr size_t MAX_RECORD_SIZE = 16 * 1024;      // tag + body of one outbound event
+constexpr size_t LANE_RING_BYTES = 512 * 1024;    // preallocated per outbound lane
+constexpr size_t CAPTURE_RING_BYTES = 512 * 1024; // raw hook input waiting for the sender (cf_deferred)
+constexpr size_t MAX_CAPTURE_SIZE = 1 + MAX_USERMSG_SIZE; // tag + the longest raw hook input
+constexpr int CAPTURE_BATCH = 256;                 // captures decoded per sender pass
+static_assert(MAX_MESSAGE_STRING < MAX_CAPTURE_SIZE && SYS_LINE_FLUSH < MAX_CAPTURE_SIZE,
+    "every raw hook input must fit one capture record");
+static_assert(MAX_USERMSG_SIZE + MAX_MESSAGE_ARGS < MAX_RECORD_SIZE, "an expanded user message must fit one record");
+constexpr size_t MIN_QUEUE_BYTES = 32 * 1024;      // room for the largest record
+constexpr size_t MAX_STATS_REPORT = 1000;         // fits one v2 frame at MIN_FRAME_MTU, sequence header included
+constexpr int DEFAULT_LISTEN_PORT = 26001;
+constexpr int DEFAULT_SERVER_PORT = 26000;
+constexpr int THREAD_JOIN_TIMEOUT_MS = 2000;
+constexpr int DESTINATION_RETRY_MS = 5000;
+constexpr int REACTOR_BATCH = 256;                 // records sent / datagrams read before the reactor turns to the other side
+constexpr uint32_t DEDUP_TABLE_SIZE = 1024;        // power of two
+constexpr uint32_t DEDUP_PROBES = 8;
+constexpr size_t MAX_FILTER_RULES = 1024;
+constexpr size_t MAX_FILTER_PATTERN = 256;
+constexpr char URGENT_COMMAND_PREFIX = '!';          // "!cmd" jumps the inbound queue
+
+// Message Source Tags
+constexpr char MSG_TYPE_CHAT  = '\x12';
+constexpr char MSG_TYPE_GAME  = '\x13';
+constexpr char MSG_TYPE_NET   = '\x14';
+constexpr char MSG_TYPE_SYS   = '\x15';
+constexpr char MSG_TYPE_STUFF = '\x16';
+constexpr char MSG_TYPE_STATS = '\x17';          // periodic cf_stats report, never queued
+constexpr char MSG_TYPE_FRAGMENT = '\x18';       // one piece of an event larger than a datagram
+constexpr char MSG_STRUCTURED_FLAG = '\x20';     // tag | flag: body is a cf_encoding 1 field list
+constexpr int LANE_COUNT = 5;                      // one outbound lane per tag, CHAT..STUFF
+constexpr int ALL_TAGS = (1 << LANE_COUNT) - 1;     // tag mask bit 0 = CHAT ... bit 4 = STUFF
+constexpr int MAX_DESTINATIONS = 8;                 // cf_server_ip plus up to 7 cf_destinations targets
+
+// Protocol v2 (framed) parameters
+constexpr unsigned char PROTOCOL_V2_MAGIC = 0xCF;
+constexpr unsigned char PROTOCOL_V2_VERSION = 2;
+constexpr size_t PROTOCOL_V2_HEADER_SIZE = 2;
+constexpr size_t DEFAULT_FRAME_MTU = 1400;
+constexpr size_t MIN_FRAME_MTU = PROTOCOL_V2_HEADER_SIZE + 3 + 1024; // a 1 KB record still fits unfragmented
+constexpr size_t MAX_FRAME_MTU = 65507;
+
+// Sequenced delivery (cf_reliable): [magic][uint32 LE seq] ahead of each v1 datagram or v2 frame.
+// Receivers NACK gaps to cf_listen_port with
+// [magic][NACK_TYPE][uint32 LE ack][count] { [uint32 LE first seq][uint16 LE length] } x count
+constexpr unsigned char SEQUENCE_MAGIC = 0xCE;
+constexpr size_t SEQUENCE_HEADER_SIZE = 5;
+constexpr unsigned char NACK_TYPE = 0x01;
+constexpr size_t NACK_HEADER_SIZE = 7;
+constexpr size_t NACK_RANGE_SIZE = 6;
+constexpr size_t MAX_PENDING_NACK_RANGES = 256;   // queued for the send path; more are dropped
+constexpr uint32_t RETRANSMIT_BATCH = 1024;        // datagrams resent per reactor pass
+constexpr size_t DEFAULT_RETRANSMIT_BYTES = 256 * 1024;
+constexpr size_t MIN_RETRANSMIT_BYTES = 128 * 1024; // always holds the largest datagram
+constexpr size_t MAX_RETRANSMIT_BYTES = 16 * 1024 * 1024;
+
+// Structured events (cf_encoding 1): { [field][varint length][value] } ..., integers as varints
+constexpr size_t EVENT_FIELD_OVERHEAD = 64;        // every field but the strings, plus their headers
+static_assert(MAX_USERMSG_SIZE + EVENT_FIELD_OVERHEAD < MAX_RECORD_SIZE &&
+    MAX_MESSAGE_STRING + EVENT_FIELD_OVERHEAD < MAX_RECORD_SIZE, "a structured event must fit one record");
+
+// Fragments: [MSG_TYPE_FRAGMENT][tag][uint16 LE id][index][count][piece of the body]
+constexpr size_t FRAGMENT_HEADER_SIZE = 5;         // tag, id, index, count
+static_assert(MAX_RECORD_SIZE / (MIN_FRAME_MTU - PROTOCOL_V2_HEADER_SIZE - 4 - FRAGMENT_HEADER_SIZE) < 255,
+    "fragment count must fit a byte");
+
+// On-disk spool (cf_spool): segment files of [header] { [uint32 length][tag][body] } ..., host byte order
+constexpr size_t SPOOL_SEGMENT_BYTES = 1024 * 1024;
+constexpr size_t SPOOL_HEADER_SIZE = 32;           // magic, serial, read and write offsets
+constexpr size_t DEFAULT_SPOOL_BYTES = 16 * 1024 * 1024;
+constexpr size_t MIN_SPOOL_BYTES = 2 * SPOOL_SEGMENT_BYTES; // one segment written while another replays
+constexpr size_t MAX_SPOOL_BYTES = 1024 * SPOOL_SEGMENT_BYTES;
+constexpr int SPOOL_REPLAY_BATCH = 256;            // records replayed per sender pass
+static_assert(SPOOL_HEADER_SIZE + 4 + MAX_RECORD_SIZE <= SPOOL_SEGMENT_BYTES, "a segment must hold the largest record");
+
+size_t CleanMessage(const char* input, size_t len, char* out);
+
+// Classes
+
+// One cf_destinations target: "host:port" or "host:port/tags"
+struct DestinationSpec {
+    char host[128];
+    int port;
+    int tags;
+};
+
+// Immutable view of all cvars, rebuilt on the game thread at most once per HUD_Frame and
+// only when a cvar string actually changed. Hooks and workers read plain fields instead of
+// parsing engine-owned cvar memory, which worker threads must not touch anyway.
+struct ConfigSnapshot {
+    uint32_t epoch = 0;
+    bool enabled = false;
+    bool debug = false;
+    bool listenOnly = false;
+    double commandDelay = 0.0;
+    int commandsPerFrame = 1;
+    long commandFrameUs = 0;
+    double commandRate = 0.0;
+    double commandBurst = 1.0;
+    double statsInterval = 0.0;
+    bool deferred = false;
+    int listenPort = DEFAULT_LISTEN_PORT;
+    size_t laneBytes[LANE_COUNT] = {};
+    bool laneDropOldest[LANE_COUNT] = {};
+    int laneWeights[LANE_COUNT] = {};
+    int protocol = 1;
+    size_t frameMtu = DEFAULT_FRAME_MTU;
+    bool reliable = false;
+    size_t retransmitBytes = DEFAULT_RETRANSMIT_BYTES;
+    bool spool = false;
+    char spoolPath[260] = {};
+    size_t spoolBytes = DEFAULT_SPOOL_BYTES;
+    double spoolRate = 0.0;
+    bool spoolAuto = false;
+    long flushUs = 0;
+    bool filter = false;
+    int encoding = 0;
+    long commandReplyMs = 250;
+    bool dedup = false;
+    uint32_t dedupWindowMs = 0;
+    int dedupTags = 0;
+    char serverIp[256] = {};
+    char serverPort[16] = {};
+    DestinationSpec destinations[MAX_DESTINATIONS - 1] = {};
+    int destinationCount = 0;
+};
+
+// Publishes ConfigSnapshot through an atomic pointer. Readers may hold a snapshot for as
+// long as they like: replaced snapshots are retired, not freed, until the plugin unloads.
+// Cvars change rarely, so the retired list stays tiny.
+class ConfigStore {
+public:
+    const ConfigSnapshot& current() const {
+        return *current_.load(std::memory_order_acquire);
+    }
+
+    // Game thread only
+    void publish(const ConfigSnapshot& snapshot) {
+        std::unique_ptr<ConfigSnapshot> next(new ConfigSnapshot(snapshot));
+        next->epoch = current().epoch + 1;
+        current_.store(next.get(), std::memory_order_release);
+        retired_.push_back(std::move(next));
+    }
+
+private:
+    ConfigSnapshot defaults_;
+    std::atomic<const ConfigSnapshot*> current_{ &defaults_ };
+    std::vector<std::unique_ptr<ConfigSnapshot>> retired_;
+};
+
+#if CF_PROFILER
+// Log-linear histogram of nanosecond values: 8 linear sub-buckets per power of two, so a
+// reported percentile is within 12.5% of the true value. record() is two relaxed atomic
+// adds and a rarely taken max update; reading races benignly with writers.
+class LatencyHistogram {
+public:
+    void record(uint64_t ns) {
+        if (ns > MAX_VALUE) ns = MAX_VALUE;
+        counts_[BucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        if (ns > max_.load(std::memory_order_relaxed)) {
+            max_.store(ns, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket holding the q-th quantile (0 < q <= 1); 0 if empty
+    uint64_t percentile(double q) const {
+        uint64_t total = 0;
+        for (const auto& bucket : counts_) total += bucket.load(std::memory_order_relaxed);
+        if (total == 0) return 0;
+        uint64_t rank = (uint64_t)(q * (double)total + 0.5);
+        if (rank < 1) rank = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            seen += counts_[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return (std::min)(BucketUpperBound(i), max());
+            }
+        }
+        return max();
+    }
+
+    void reset() {
+        for (auto& bucket : counts_) bucket.store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr int SUB_BITS = 3;
+    static constexpr int SUB_COUNT = 1 << SUB_BITS;
+    static constexpr int MAX_BIT = 39;                 // ~9 minutes; larger values are clamped
+    static constexpr uint64_t MAX_VALUE = (1ull << (MAX_BIT + 1)) - 1;
+    static constexpr int BUCKET_COUNT = (MAX_BIT - SUB_BITS + 2) * SUB_COUNT;
+
+    static int HighestBit(uint64_t value) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        if (_BitScanReverse(&index, (unsigned long)(value >> 32))) return (int)index + 32;
+        _BitScanReverse(&index, (unsigned long)value);
+        return (int)index;
+#else
+        return 63 - __builtin_clzll(value);
+#endif
+    }
+    static int BucketOf(uint64_t value) {
+        if (value < SUB_COUNT) return (int)value;
+        int shift = HighestBit(value) - SUB_BITS;
+        return (shift + 1) * SUB_COUNT + (int)((value >> shift) - SUB_COUNT);
+    }
+    static uint64_t BucketUpperBound(int index) {
+        if (index < SUB_COUNT) return (uint64_t)index;
+        int shift = index / SUB_COUNT - 1;
+        return ((uint64_t)(index % SUB_COUNT + SUB_COUNT) << shift) + (1ull << shift) - 1;
+    }
+
+    std::atomic<uint32_t> counts_[BUCKET_COUNT] = {};
+    std::atomic<uint64_t> count_{ 0 };
+    std::atomic<uint64_t> max_{ 0 };
+};
+
+// Per-tag histograms for each stage of an outbound event, inbound command wait time and
+// the per-frame total spent inside our hooks. Timestamps are MonotonicTicks() (QPC on
+// Windows, CLOCK_MONOTONIC elsewhere), converted to nanoseconds only when recorded.
+class LatencyProfiler {
+public:
+    enum Stage {
+        STAGE_HOOK,     // hook entry -> exit, engine's original handler excluded
+        STAGE_QUEUE,    // enqueue -> dequeue by the sender
+        STAGE_SEND,     // dequeue -> sendto returned (includes v2 frame coalescing)
+        STAGE_TOTAL,    // enqueue -> sendto returned
+        STAGE_COUNT
+    };
+
+    LatencyHistogram outbound[STAGE_COUNT][LANE_COUNT];
+    LatencyHistogram commandWait;       // received -> pfnClientCmd
+    LatencyHistogram frameHooks;        // per-frame hook total, frames with hook activity only
+
+    static int64_t Now() {
+        return MonotonicTicks();
+    }
+    static uint64_t ToNs(int64_t ticks) {
+        static const int64_t frequency = MonotonicFrequency();
+        if (ticks <= 0) return 0;
+        return (uint64_t)(ticks / frequency) * 1000000000ull +
+            (uint64_t)(ticks % frequency) * 1000000000ull / (uint64_t)frequency;
+    }
+
+    void recordOutbound(Stage stage, int lane, int64_t from, int64_t to) {
+        outbound[stage][lane].record(ToNs(to - from));
+    }
+    void addHookTime(int lane, int64_t ticks) {
+        outbound[STAGE_HOOK][lane].record(ToNs(ticks));
+        frameHookTicks_.fetch_add(ticks, std::memory_order_relaxed);
+    }
+
+    // Game thread, once per HUD_Frame
+    void endFrame() {
+        int64_t ticks = frameHookTicks_.exchange(0, std::memory_order_relaxed);
+        lastFrameHookNs_ = ToNs(ticks);
+        if (ticks > 0) {
+            frameHooks.record(lastFrameHookNs_);
+        }
+    }
+    uint64_t lastFrameHookNs() const { return lastFrameHookNs_; }
+
+    void reset() {
+        for (auto& stage : outbound) {
+            for (auto& histogram : stage) histogram.reset();
+        }
+        commandWait.reset();
+        frameHooks.reset();
+    }
+
+private:
+    std::atomic<int64_t> frameHookTicks_{ 0 };
+    uint64_t lastFrameHookNs_ = 0;
+};
+
+extern LatencyProfiler g_profiler;
+
+// Measures one hook invocation, to the end of the enclosing scope
+class HookTimer {
+public:
+    explicit HookTimer(char tag) : lane_(tag - MSG_TYPE_CHAT), start_(LatencyProfiler::Now()) {}
+    ~HookTimer() { g_profiler.addHookTime(lane_, LatencyProfiler::Now() - start_); }
+private:
+    int lane_;
+    int64_t start_;
+};
+
+inline int64_t ProfileNow() { return LatencyProfiler::Now(); }
+#define CF_PROFILE_HOOK(timer, tag) HookTimer timer(tag)
+#else
+inline int64_t ProfileNow() { return 0; }
+#define CF_PROFILE_HOOK(timer, tag) ((void)0)
+#endif
+
+// Bounded lock-free multi-producer/single-consumer ring of variable-length records.
+// Records are [uint32 header][int64 stamp][tag][body] padded to 8 bytes and packed back
+// to back (the stamp only exists in CF_PROFILER builds),
+// so a queued event costs its real size instead of a fixed slot. Producers reserve
+// space with a CAS on head_, fill the record and publish it by storing the length
+// into the header. The consumer zeroes everything it consumes, so a reserved but
+// unpublished header always reads as 0. No allocation after init(), and producers
+// never lock on the fast path. The usable byte budget can be lowered at runtime.
+// With drop-oldest set, a producer that finds the ring full evicts the oldest record
+// itself; consumer_ serializes that eviction with the real consumer.
+class RecordRing {
+public:
+    ~RecordRing() { delete[] buffer_; }
+
+    // Allocates the ring once; capacityBytes must be a power of two.
+    bool init(size_t capacityBytes, size_t maxRecordBytes = MAX_RECORD_SIZE) {
+        if (buffer_) return true;
+        maxRecord_ = maxRecordBytes;
+        buffer_ = new (std::nothrow) uint64_t[capacityBytes / sizeof(uint64_t)]();
+        if (!buffer_) {
+            return false;
+        }
+        capacity_ = (uint32_t)capacityBytes;
+        mask_ = capacity_ - 1;
+        budget_.store(capacity_, std::memory_order_relaxed);
+        return true;
+    }
+
+    void setBudget(size_t bytes) {
+        if (bytes < MIN_QUEUE_BYTES) bytes = MIN_QUEUE_BYTES;
+        if (bytes > capacity_) bytes = capacity_;
+        budget_.store((uint32_t)bytes, std::memory_order_relaxed);
+    }
+
+    void setDropOldest(bool dropOldest) {
+        dropOldest_.store(dropOldest, std::memory_order_relaxed);
+    }
+
+    // Safe to call from any thread. Bodies longer than the ring's record size - 1
+    // (MAX_RECORD_SIZE unless init() said otherwise) are truncated.
+    bool push(char tag, const char* data, size_t len, int64_t stamp = 0) {
+        if (!buffer_) {
+            return false;
+        }
+        if (len > maxRecord_ - 1) {
+            len = maxRecord_ - 1;
+        }
+
+        const uint32_t recordSize = AlignRecord(PREFIX_SIZE + 1 + len);
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t pad;
+        int evictions = 0;
+        for (;;) {
+            // A record never wraps: the tail end of the buffer is skipped with a pad record
+            uint32_t room = capacity_ - (head & mask_);
+            pad = room < recordSize ? room : 0;
+            uint32_t used = head + pad + recordSize - tail_.load(std::memory_order_acquire);
+            if (used > capacity_ || used > budget_.load(std::memory_order_relaxed) + pad) {
+                if (dropOldest_.load(std::memory_order_relaxed) && evictions < MAX_EVICTIONS && evictOldest()) {
+                    evictions++;
+                    head = head_.load(std::memory_order_relaxed);
+                    continue;
+                }
+                overflowed_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (head_.compare_exchange_weak(head, head + pad + recordSize,
+                std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                // Approximate high-water mark; a racing producer may lose a larger value
+                if (used > highWater_.load(std::memory_order_relaxed)) {
+                    highWater_.store(used, std::memory_order_relaxed);
+                }
+                break;
+            }
+        }
+
+        if (pad) {
+            Header(head).store(PAD_FLAG | pad, std::memory_order_release);
+            head += pad;
+        }
+        char* record = At(head);
+        if (STAMP_SIZE) {
+            memcpy(record + HEADER_SIZE, &stamp, STAMP_SIZE);
+        }
+        record[PREFIX_SIZE] = tag;
+        memcpy(record + PREFIX_SIZE + 1, data, len);
+        Header(head).store((uint32_t)(1 + len), std::memory_order_release);
+        return true;
+    }
+
+    // Single consumer only. Copies [tag][body] of the oldest record into out.
+    bool tryPop(char* out, size_t outSize, size_t& outLen, int64_t* stamp = nullptr) {
+        if (!buffer_) {
+            return false;
+        }
+        LockConsumer();
+        bool popped = popLocked(out, outSize, outLen, stamp);
+        consumer_.clear(std::memory_order_release);
+        return popped;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    size_t sizeBytes() const {
+        return head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t overflowed() const { return overflowed_.load(std::memory_order_relaxed); }
+    uint64_t evicted() const { return evicted_.load(std::memory_order_relaxed); }
+    uint32_t highWater() const { return highWater_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr uint32_t HEADER_SIZE = sizeof(uint32_t);
+    static constexpr uint32_t STAMP_SIZE = CF_PROFILER ? sizeof(int64_t) : 0;
+    static constexpr uint32_t PREFIX_SIZE = HEADER_SIZE + STAMP_SIZE;
+    static constexpr uint32_t PAD_FLAG = 0x80000000u;
+    static constexpr int MAX_EVICTIONS = 4;
+
+    static uint32_t AlignRecord(size_t size) {
+        return (uint32_t)((size + 7) & ~(size_t)7);
+    }
+    char* At(uint32_t pos) const {
+        return reinterpret_cast<char*>(buffer_) + (pos & mask_);
+    }
+    std::atomic<uint32_t>& Header(uint32_t pos) const {
+        return *reinterpret_cast<std::atomic<uint32_t>*>(At(pos));
+    }
+
+    // Uncontended unless a drop-oldest producer is evicting at the same moment
+    void LockConsumer() {
+        while (consumer_.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    bool evictOldest() {
+        LockConsumer();
+        size_t discardedLen;
+        bool evicted = popLocked(nullptr, 0, discardedLen);
+        consumer_.clear(std::memory_order_release);
+        if (evicted) {
+            evicted_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return evicted;
+    }
+
+    // out == nullptr discards the record
+    bool popLocked(char* out, size_t outSize, size_t& outLen, int64_t* stamp = nullptr) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            if (tail == head_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            uint32_t header = Header(tail).load(std::memory_order_acquire);
+            if (header == 0) {
+                return false; // reserved, producer still writing
+            }
+
+            uint32_t recordSize;
+            bool isPad = (header & PAD_FLAG) != 0;
+            if (isPad) {
+                recordSize = header & ~PAD_FLAG;
+            }
+            else {
+                outLen = out ? (std::min)((size_t)header, outSize) : 0;
+                if (out) {
+                    memcpy(out, At(tail) + PREFIX_SIZE, outLen);
+                }
+                if (stamp) {
+                    *stamp = 0;
+                    if (STAMP_SIZE) {
+                        memcpy(stamp, At(tail) + HEADER_SIZE, STAMP_SIZE);
+                    }
+                }
+                recordSize = AlignRecord(PREFIX_SIZE + header);
+            }
+
+            Header(tail).store(0, std::memory_order_relaxed);
+            memset(At(tail) + HEADER_SIZE, 0, recordSize - HEADER_SIZE);
+            tail += recordSize;
+            tail_.store(tail, std::memory_order_release);
+            if (!isPad) {
+                return true;
+            }
+        }
+    }
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "record header must be a plain 32-bit word");
+
+    uint64_t* buffer_ = nullptr;
+    uint32_t capacity_ = 0;
+    uint32_t mask_ = 0;
+    size_t maxRecord_ = MAX_RECORD_SIZE;
+    std::atomic<uint32_t> budget_{ 0 };
+    std::atomic<bool> dropOldest_{ false };
+    alignas(64) std::atomic<uint32_t> head_{ 0 };
+    alignas(64) std::atomic<uint32_t> tail_{ 0 };
+    std::atomic_flag consumer_ = ATOMIC_FLAG_INIT;
+    std::atomic<uint64_t> overflowed_{ 0 };
+    std::atomic<uint64_t> evicted_{ 0 };
+    std::atomic<uint32_t> highWater_{ 0 };
+};
+
+// Why an outbound event never reached the wire. Queue overflow and eviction are counted
+// by the lanes themselves (RecordRing), the rest here.
+enum DropReason {
+    DROP_FILTERED,
+    DROP_DUPLICATE,
+    DROP_NO_ROUTE,
+    DROP_SEND_ERROR,
+    DROP_REASON_COUNT
+};
+
+// Lock-free traffic counters, readable at any time through cf_stats or the stats datagram.
+// Outbound counters are per lane (= per tag), inbound ones cover the command path.
+class ForwarderStats {
+public:
+    struct Lane {
+        std::atomic<uint64_t> enqueued{ 0 };
+        std::atomic<uint64_t> enqueuedBytes{ 0 };
+        std::atomic<uint64_t> sent{ 0 };
+        std::atomic<uint64_t> sentBytes{ 0 };
+        std::atomic<uint64_t> dropped[DROP_REASON_COUNT] = {};
+    };
+
+    // Per target: [0] is cf_server_ip, [1..] the cf_destinations entries in order
+    struct Destination {
+        std::atomic<uint64_t> datagrams{ 0 };
+        std::atomic<uint64_t> bytes{ 0 };
+        std::atomic<uint64_t> errors{ 0 };
+    };
+
+    Lane lanes[LANE_COUNT];
+    Destination destinations[MAX_DESTINATIONS];
+    std::atomic<uint64_t> datagrams{ 0 };
+    std::atomic<uint64_t> datagramBytes{ 0 };
+    std::atomic<uint64_t> sendErrors{ 0 };
+    std::atomic<uint64_t> fragments{ 0 };
+    std::atomic<uint64_t> nacks{ 0 };
+    std::atomic<uint64_t> retransmitted{ 0 };
+    std::atomic<uint64_t> retransmitMissed{ 0 };
+    std::atomic<uint32_t> lastSequence{ 0 };
+    std::atomic<uint64_t> captured{ 0 };
+    std::atomic<uint64_t> spooled{ 0 };
+    std::atomic<uint64_t> spoolReplayed{ 0 };
+    std::atomic<uint64_t> commandsReceived{ 0 };
+    std::atomic<uint64_t> commandBytes{ 0 };
+    std::atomic<uint64_t> commandsDropped{ 0 };
+    std::atomic<uint64_t> commandsExecuted{ 0 };
+    std::atomic<uint32_t> commandHighWater{ 0 };
+    std::atomic<uint64_t> reactorWakeups{ 0 };   // returns from the reactor's blocking wait; not in the report
+
+    static void Add(std::atomic<uint64_t>& counter, uint64_t value = 1) {
+        counter.fetch_add(value, std::memory_order_relaxed);
+    }
+    static unsigned long long Get(const std::atomic<uint64_t>& counter) {
+        return counter.load(std::memory_order_relaxed);
+    }
+
+    // Multi-line "key=value" report shared by cf_stats and the stats datagram
+    size_t format(char* out, size_t size) const;
+};
+
+extern ForwarderStats g_stats;
+
+// Outbound queue: one RecordRing lane per tag, so a SYS/NET flood can only overflow its
+// own lane. The sender drains lanes with weighted round robin: each turn a lane may send
+// up to its weight in records before the next non-empty lane is served, which bounds the
+// wait of a CHAT/GAME record by the sum of the other weights.
+// A consumer about to block raises waiting_; producers only pay for SetEvent then.
+// The queue's event is also the reactor's wake: wake() for config changes and replies.
+// In deferred mode (cf_deferred) hooks only capture() their raw input; the sender decodes
+// it with takeCapture() and pushes the result into the lanes like a hook would.
+class SendQueue {
+public:
+    bool init(size_t laneBytes) {
+        for (RecordRing& lane : lanes_) {
+            if (!lane.init(laneBytes)) {
+                return false;
+            }
+        }
+        return capture_.init(CAPTURE_RING_BYTES, MAX_CAPTURE_SIZE);
+    }
+
+    void configureLane(int lane, size_t budgetBytes, bool dropOldest, int weight) {
+        lanes_[lane].setBudget(budgetBytes);
+        lanes_[lane].setDropOldest(dropOldest);
+        weights_[lane].store((std::max)(weight, 1), std::memory_order_relaxed);
+    }
+
+    // Safe to call from any thread. stamp is the ProfileNow() enqueue time.
+    bool push(char tag, const char* data, size_t len, int64_t stamp = 0) {
+        if (shutdown_.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        int lane = LaneOf(tag);
+        if (!lanes_[lane].push(tag, data, len, stamp)) {
+            return false;
+        }
+        ForwarderStats::Add(g_stats.lanes[lane].enqueued);
+        ForwarderStats::Add(g_stats.lanes[lane].enqueuedBytes, len);
+        signal();
+        return true;
+    }
+
+    // Safe to call from any thread. Queues raw hook input (tag + up to MAX_CAPTURE_SIZE - 1
+    // bytes) for the sender to decode.
+    bool capture(char tag, const char* data, size_t len, int64_t stamp = 0) {
+        if (shutdown_.load(std::memory_order_relaxed) || !capture_.push(tag, data, len, stamp)) {
+            return false;
+        }
+        ForwarderStats::Add(g_stats.captured);
+        signal();
+        return true;
+    }
+
+    // Single consumer only (the sender). Copies [tag][raw input] of the oldest capture.
+    bool takeCapture(char* out, size_t outSize, size_t& outLen, int64_t* stamp = nullptr) {
+        return capture_.tryPop(out, outSize, outLen, stamp);
+    }
+
+    // Single consumer only. Copies [tag][body] of the next scheduled record into out.
+    bool pop(char* out, size_t outSize, size_t& outLen, int64_t* stamp = nullptr) {
+        return tryPop(out, outSize, outLen, stamp);
+    }
+
+    // Single consumer only. Blocks up to timeout_ms (< 0 = forever) until wake(), shutdown(),
+    // a datagram on sock (if any) or, with records set, a new record or capture.
+    SocketWait wait(UdpSocket* sock, int timeout_ms, bool records) {
+        if (shutdown_.load(std::memory_order_relaxed)) {
+            return SOCKET_WOKEN;
+        }
+        if (records) {
+            waiting_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!idle()) {
+                waiting_.store(false, std::memory_order_relaxed);
+                return SOCKET_WOKEN;
+            }
+        }
+        SocketWait result = sock ? sock->waitReadable(event_, timeout_ms)
+            : event_.wait(timeout_ms) ? SOCKET_WOKEN : SOCKET_TIMEOUT;
+        waiting_.store(false, std::memory_order_relaxed);
+        return result;
+    }
+
+    // Interrupts a blocked wait(), e.g. after a config change.
+    void wake() {
+        event_.set();
+    }
+
+    void shutdown() {
+        shutdown_.store(true, std::memory_order_release);
+        event_.set();
+    }
+
+    const RecordRing& lane(int index) const { return lanes_[index]; }
+    const RecordRing& captureRing() const { return capture_; }
+
+    // No record in any lane and no capture left to decode
+    bool idle() const {
+        for (const RecordRing& lane : lanes_) {
+            if (!lane.empty()) {
+                return false;
+            }
+        }
+        return capture_.empty();
+    }
+
+    static int LaneOf(char tag) {
+        int lane = (tag & ~MSG_STRUCTURED_FLAG) - MSG_TYPE_CHAT;
+        return (lane >= 0 && lane < LANE_COUNT) ? lane : LANE_COUNT - 1;
+    }
+
+private:
+    // Pairs with the fence in wait(): either the consumer sees the new record or we see it waiting
+    void signal() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting_.load(std::memory_order_relaxed) && waiting_.exchange(false, std::memory_order_relaxed)) {
+            event_.set();
+        }
+    }
+
+    bool tryPop(char* out, size_t outSize, size_t& outLen, int64_t* stamp) {
+        for (int advanced = 0; advanced <= LANE_COUNT; ) {
+            if (credit_ <= 0) {
+                current_ = (current_ + 1) % LANE_COUNT;
+                credit_ = weights_[current_].load(std::memory_order_relaxed);
+                advanced++;
+            }
+            if (lanes_[current_].tryPop(out, outSize, outLen, stamp)) {
+                credit_--;
+                return true;
+            }
+            credit_ = 0; // lane empty: its turn ends early
+        }
+        return false;
+    }
+
+    RecordRing lanes_[LANE_COUNT];
+    RecordRing capture_;
+    std::atomic<int> weights_[LANE_COUNT] = {};
+    int current_ = LANE_COUNT - 1;
+    int credit_ = 0;
+    std::atomic<bool> shutdown_{ false };
+    std::atomic<bool> waiting_{ false };
+    WakeEvent event_;
+};
+
+// Outbound addresses as seen by the sender. Only the sender thread touches its copy.
+struct ResolvedDestination {
+    struct Extra {
+        sockaddr_in addr;
+        int tags;
+        bool valid;
+    };
+
+    sockaddr_in addr = {};
+    bool valid = false;
+    Extra extras[MAX_DESTINATIONS - 1] = {};   // cf_destinations; unresolved ones are skipped
+    int extraCount = 0;
+    bool complete = false;                      // every target resolved
+    uint32_t generation = 0;                    // of the config it was resolved for
+    uint32_t published = 0;                     // DestinationCache results so far, this one included
+};
+
+// Pre-resolved destination cache. The game thread publishes cf_server_ip/cf_server_port
+// and the cf_destinations table only when they change, bumping a generation counter.
+// Dotted quads are parsed right there. Hostnames go to a resolver thread, because
+// getaddrinfo can block for seconds; it retries every DESTINATION_RETRY_MS until every
+// target resolves. The sender only copies the latest result, so it never resolves anything
+// and nobody parses an address per packet.
+class DestinationCache {
+public:
+    ~DestinationCache() { stop(); }
+
+    // Game thread only. Two short strcmp calls and a memcmp when nothing changed.
+    void update(const char* host, const char* port, const DestinationSpec* extras, int extraCount);
+
+    // Sender thread only. Returns false while cf_server_ip has no usable address;
+    // cf_destinations targets come along with it.
+    bool refresh(ResolvedDestination& dest) {
+        if (published_.load(std::memory_order_acquire) != dest.published) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            dest = resolved_;
+        }
+        return dest.valid;
+    }
+
+    // Ends the resolver thread; the next hostname starts it again
+    void stop();
+
+private:
+    // Fills dest from the targets; numericOnly leaves hostnames unresolved
+    static void Resolve(const char* host, const char* port, const DestinationSpec* extras, int extraCount,
+        bool numericOnly, ResolvedDestination& dest);
+    void publish(const ResolvedDestination& dest);
+    void run();
+
+    char host_[256] = {};
+    char port_[16] = {};
+    DestinationSpec extras_[MAX_DESTINATIONS - 1] = {};
+    int extraCount_ = 0;
+    uint32_t generation_ = 0;
+    ResolvedDestination resolved_;
+    std::mutex mutex_;
+    std::atomic<uint32_t> published_{ 0 };
+
+    std::thread resolver_;
+    std::atomic<bool> stopping_{ false };
+    WakeEvent wake_;
+};
+
+// Protocol v2 datagram: [magic][version] followed by [tag][varint length][body] records.
+// The magic byte is outside the tag range, so receivers can tell v1 and v2 packets apart.
+class FrameBuilder {
+public:
+    void reset(size_t mtu) {
+        mtu_ = (std::min)(mtu, sizeof(buffer_));
+        buffer_[0] = (char)PROTOCOL_V2_MAGIC;
+        buffer_[1] = (char)PROTOCOL_V2_VERSION;
+        len_ = PROTOCOL_V2_HEADER_SIZE;
+    }
+
+    // Returns false if the record does not fit; the caller flushes and retries.
+    bool append(char tag, const char* body, size_t bodyLen) {
+        char varint[5];
+        size_t varintLen = 0;
+        size_t value = bodyLen;
+        do {
+            unsigned char byte = value & 0x7F;
+            value >>= 7;
+            varint[varintLen++] = (char)(value ? (byte | 0x80) : byte);
+        } while (value);
+
+        if (len_ + 1 + varintLen + bodyLen > mtu_) {
+            return false;
+        }
+        buffer_[len_++] = tag;
+        memcpy(buffer_ + len_, varint, varintLen);
+        len_ += varintLen;
+        memcpy(buffer_ + len_, body, bodyLen);
+        len_ += bodyLen;
+        return true;
+    }
+
+    // True if a record with this body fits an empty frame
+    bool fits(size_t bodyLen) const {
+        size_t varintLen = 1;
+        for (size_t value = bodyLen >> 7; value; value >>= 7) varintLen++;
+        return PROTOCOL_V2_HEADER_SIZE + 1 + varintLen + bodyLen <= mtu_;
+    }
+
+    // Calls visit(tag, body, bodyLen) for each record in the frame, in order
+    template <typename Visit>
+    void forEach(Visit visit) const {
+        for (size_t pos = PROTOCOL_V2_HEADER_SIZE; pos < len_; ) {
+            char tag = buffer_[pos++];
+            size_t bodyLen = 0;
+            unsigned char byte;
+            int shift = 0;
+            do {
+                byte = (unsigned char)buffer_[pos++];
+                bodyLen |= (size_t)(byte & 0x7F) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+            visit(tag, buffer_ + pos, bodyLen);
+            pos += bodyLen;
+        }
+    }
+
+    bool empty() const { return len_ <= PROTOCOL_V2_HEADER_SIZE; }
+    const char* data() const { return buffer_; }
+    size_t size() const { return len_; }
+    size_t mtu() const { return mtu_; }
+
+private:
+    char buffer_[MAX_FRAME_MTU];
+    size_t len_ = PROTOCOL_V2_HEADER_SIZE;
+    size_t mtu_ = DEFAULT_FRAME_MTU;
+};
+
+// Field ids of a structured event body. Receivers skip fields they do not know.
+enum EventField {
+    EVENT_TIME = 1,     // capture time, microseconds since the Unix epoch
+    EVENT_SEQ = 2,      // per-plugin event counter; a gap means events were dropped
+    EVENT_CLIENT = 3,   // SayText sender's client index
+    EVENT_DEST = 4,     // TextMsg msg_dest (1 notify, 2 console, 3 chat, 4 center)
+    EVENT_KEY = 5,      // cleaned format string as sent, e.g. #Game_joined_game
+    EVENT_ARG = 6,      // one cleaned argument, repeated in message order
+    EVENT_TEXT = 7      // cleaned text of a print/stufftext/debug event
+};
+
+// Writes a structured event body: { [field][varint length][value] } ..., with integer
+// values as varints too. Strings past the record limit are cut off.
+class EventEncoder {
+public:
+    void reset() { len_ = 0; }
+
+    void addInt(EventField field, uint64_t value) {
+        char varint[10];
+        size_t varintLen = PutVarint(varint, value);
+        if (len_ + 2 + varintLen <= sizeof(buffer_)) {
+            buffer_[len_++] = (char)field;
+            buffer_[len_++] = (char)varintLen;
+            memcpy(buffer_ + len_, varint, varintLen);
+            len_ += varintLen;
+        }
+    }
+
+    // Cleans raw straight into the body; the length goes in front once it is known
+    void addCleaned(EventField field, const char* raw, size_t rawLen) {
+        if (len_ + 3 > sizeof(buffer_)) {
+            return;
+        }
+        size_t start = len_ + 2;
+        size_t room = sizeof(buffer_) - 1 - start;
+        size_t cleanLen = CleanMessage(raw, (std::min)(rawLen, room), buffer_ + start);
+        char varint[10];
+        size_t varintLen = PutVarint(varint, cleanLen);
+        if (varintLen > 1) {
+            memmove(buffer_ + start + varintLen - 1, buffer_ + start, cleanLen);
+        }
+        buffer_[len_++] = (char)field;
+        memcpy(buffer_ + len_, varint, varintLen);
+        len_ += varintLen + cleanLen;
+    }
+
+    void addString(EventField field, const char* text, size_t len) {
+        if (len_ + 3 > sizeof(buffer_)) {
+            return;
+        }
+        len = (std::min)(len, sizeof(buffer_) - len_ - 3); // lengths take at most two varint bytes
+        buffer_[len_++] = (char)field;
+        len_ += PutVarint(buffer_ + len_, len);
+        memcpy(buffer_ + len_, text, len);
+        len_ += len;
+    }
+
+    const char* data() const { return buffer_; }
+    size_t size() const { return len_; }
+
+private:
+    static size_t PutVarint(char* out, uint64_t value) {
+        size_t len = 0;
+        do {
+            unsigned char byte = value & 0x7F;
+            value >>= 7;
+            out[len++] = (char)(value ? (byte | 0x80) : byte);
+        } while (value);
+        return len;
+    }
+
+    char buffer_[MAX_RECORD_SIZE - 1];
+    size_t len_ = 0;
+};
+
+// Sequenced datagrams recently sent, kept for retransmission. A byte ring written
+// sequentially: each new datagram evicts the oldest ones it overlaps, so the entries
+// always hold consecutive sequence numbers and find() is an index. Sender thread only.
+class RetransmitRing {
+public:
+    void reset(size_t capacityBytes) {
+        if (buffer_.size() != capacityBytes) {
+            buffer_.assign(capacityBytes, 0);
+        }
+        entries_.clear();
+        head_ = 0;
+    }
+
+    size_t capacity() const { return buffer_.size(); }
+
+    // Room for datagram seq, which must follow the last one stored; nullptr if it cannot fit
+    char* append(uint32_t seq, size_t len) {
+        if (len > buffer_.size()) {
+            entries_.clear();
+            return nullptr;
+        }
+        if (!entries_.empty() && seq != entries_.back().seq + 1) {
+            entries_.clear();
+        }
+        size_t offset = head_;
+        if (offset + len > buffer_.size()) {
+            // Wrap: whatever still sits past head_ is older than anything at the start
+            while (!entries_.empty() && entries_.front().offset >= head_) {
+                entries_.pop_front();
+            }
+            offset = 0;
+        }
+        while (!entries_.empty() && entries_.front().offset < offset + len &&
+            entries_.front().offset + entries_.front().len > offset) {
+            entries_.pop_front();
+        }
+        entries_.push_back(Entry{ seq, offset, len });
+        head_ = offset + len;
+        return &buffer_[offset];
+    }
+
+    const char* find(uint32_t seq, size_t& len) const {
+        if (entries_.empty() || seq - entries_.front().seq >= entries_.size()) {
+            return nullptr;
+        }
+        const Entry& entry = entries_[seq - entries_.front().seq];
+        len = entry.len;
+        return &buffer_[entry.offset];
+    }
+
+private:
+    struct Entry {
+        uint32_t seq;
+        size_t offset;
+        size_t len;
+    };
+    std::vector<char> buffer_;
+    std::deque<Entry> entries_;
+    size_t head_ = 0;
+};
+
+// NACKed sequence ranges, parsed from inbound datagrams and taken by the send path. pending()
+// is a single relaxed load, so sending pays nothing while no loss is reported.
+class NackQueue {
+public:
+    struct Range {
+        uint32_t first;
+        uint32_t length;
+    };
+
+    // Reactor thread. False if data is not a well-formed NACK.
+    bool parse(const char* data, size_t len) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+        if (len < NACK_HEADER_SIZE || p[0] != SEQUENCE_MAGIC || p[1] != NACK_TYPE ||
+            len < NACK_HEADER_SIZE + (size_t)p[6] * NACK_RANGE_SIZE) {
+            return false;
+        }
+        ack_.store(ReadU32(p + 2), std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < p[6] && ranges_.size() < MAX_PENDING_NACK_RANGES; i++) {
+            const unsigned char* range = p + NACK_HEADER_SIZE + i * NACK_RANGE_SIZE;
+            ranges_.push_back(Range{ ReadU32(range), (uint32_t)(range[4] | (range[5] << 8)) });
+        }
+        pending_.store(!ranges_.empty(), std::memory_order_release);
+        return true;
+    }
+
+    bool pending() const { return pending_.load(std::memory_order_acquire); }
+
+    // Sender thread
+    void take(std::vector<Range>& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        out.swap(ranges_);
+        ranges_.clear();
+        pending_.store(false, std::memory_order_relaxed);
+    }
+
+    // Last sequence number up to which the receiver has everything
+    uint32_t ack() const { return ack_.load(std::memory_order_relaxed); }
+
+private:
+    static uint32_t ReadU32(const unsigned char* p) {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    std::mutex mutex_;
+    std::vector<Range> ranges_;
+    std::atomic<bool> pending_{ false };
+    std::atomic<uint32_t> ack_{ 0 };
+};
+
+// Splits a [tag][body] record too large for one datagram into MSG_TYPE_FRAGMENT records
+// of at most piece body bytes each. Every call to begin() takes the next 16-bit id; the
+// receiver joins the pieces of an id in index order once all count of them arrived.
+// Sender thread only.
+class Fragmenter {
+public:
+    void begin(const char* record, size_t len, size_t piece) {
+        record_ = record;
+        len_ = len;
+        piece_ = piece;
+        index_ = 0;
+        count_ = (len - 1 + piece - 1) / piece;
+        id_++;
+    }
+
+    // Builds the next fragment record; false once all of them were returned
+    bool next(const char*& out, size_t& outLen) {
+        if (index_ >= count_) {
+            return false;
+        }
+        size_t offset = 1 + index_ * piece_;
+        size_t pieceLen = (std::min)(piece_, len_ - offset);
+        buffer_[0] = MSG_TYPE_FRAGMENT;
+        buffer_[1] = record_[0];
+        buffer_[2] = (char)(id_ & 0xFF);
+        buffer_[3] = (char)(id_ >> 8);
+        buffer_[4] = (char)index_;
+        buffer_[5] = (char)count_;
+        memcpy(buffer_ + 1 + FRAGMENT_HEADER_SIZE, record_ + offset, pieceLen);
+        out = buffer_;
+        outLen = 1 + FRAGMENT_HEADER_SIZE + pieceLen;
+        index_++;
+        return true;
+    }
+
+    bool done() const { return index_ >= count_; }
+    size_t count() const { return count_; }
+
+private:
+    char buffer_[1 + FRAGMENT_HEADER_SIZE + MAX_FRAME_MTU];
+    const char* record_ = nullptr;
+    size_t len_ = 0;
+    size_t piece_ = 0;
+    size_t index_ = 0;
+    size_t count_ = 0;
+    uint16_t id_ = 0;
+};
+
+// Memory-mapped overflow log (cf_spool). Records the lanes could not take, or the sender
+// could not deliver, are appended to SPOOL_SEGMENT_BYTES files spool_NNNN.seg under
+// cf_spool_path. cf_spool_bytes decides how many segment slots exist; when all are in use
+// the oldest segment is overwritten, which caps disk use. An append is a memcpy into the
+// mapped segment under a short lock, with no syscall or fsync per record. The sender
+// replays records in append order. Each segment header keeps its read offset, so a
+// restarted client resumes where the last replay stopped.
+class Spool {
+public:
+    ~Spool() { close(); }
+
+    // Game thread (RefreshConfig). (Re)opens the spool when the directory or the cap changed
+    // and picks up unreplayed segments already on disk; an empty directory closes it.
+    bool configure(const char* directory, size_t capBytes);
+    void close();
+
+    // Any thread. False if the spool is closed or no segment could be mapped.
+    bool append(char tag, const char* data, size_t len);
+
+    // Sender thread only. peek() copies the oldest unreplayed [tag][body]; consume() drops it
+    // once it went out, so a failed replay leaves it at the head.
+    bool peek(char* out, size_t outSize, size_t& outLen);
+    void consume();
+
+    bool empty() const { return pendingBytes() == 0; }
+    uint64_t pendingBytes() const { return pending_.load(std::memory_order_relaxed); }
+    uint64_t lost() const { return lost_.load(std::memory_order_relaxed); }
+
+    // cf_spool_replay: the next sender pass replays even with cf_spool_auto 0
+    void requestReplay() { replayRequested_.store(true, std::memory_order_release); }
+    bool takeReplayRequest() { return replayRequested_.exchange(false, std::memory_order_acq_rel); }
+
+private:
+    struct Segment {
+        int slot = 0;
+        MappedFile file;
+    };
+
+    std::string pathOf(int slot) const;
+    bool rotate();
+    void retireHead();
+    void closeLocked();
+
+    std::mutex mutex_;
+    std::string directory_;
+    std::vector<bool> slotUsed_;
+    std::deque<std::unique_ptr<Segment>> segments_;   // oldest first; back() takes appends
+    uint64_t nextSerial_ = 1;
+    bool peeked_ = false;
+    uint64_t peekSerial_ = 0;
+    uint32_t peekOffset_ = 0;
+    std::atomic<uint64_t> pending_{ 0 };   // record bytes not replayed yet
+    std::atomic<uint64_t> lost_{ 0 };      // records overwritten before their replay
+    std::atomic<bool> replayRequested_{ false };
+};
+
+// Single-pass %s expansion for SayText/TextMsg. The cleaned format is consumed left to
+// right while each argument is cleaned straight into the output, so nothing is rescanned
+// or shifted. Arguments without a placeholder left are appended after a space.
+// Arguments must be added in message order.
+class MessageExpander {
+public:
+    void begin(const char* format) {
+        formatLen_ = format ? CleanMessage(format, strnlen(format, sizeof(format_) - 1), format_) : 0;
+        format_[formatLen_] = '\0';
+        cursor_ = 0;
+        len_ = 0;
+    }
+
+    void addArg(const char* arg) {
+        const char* placeholder = strstr(format_ + cursor_, "%s");
+        if (placeholder) {
+            size_t pos = placeholder - format_;
+            append(format_ + cursor_, pos - cursor_);
+            cursor_ = pos + 2;
+        }
+        else {
+            append(format_ + cursor_, formatLen_ - cursor_);
+            cursor_ = formatLen_;
+            if (len_ > 0) append(" ", 1);
+        }
+        size_t room = sizeof(out_) - 1 - len_;
+        len_ += CleanMessage(arg, strnlen(arg, room), out_ + len_);
+    }
+
+    // Returns the expanded, NUL-terminated message
+    const char* finish(size_t& len) {
+        append(format_ + cursor_, formatLen_ - cursor_);
+        cursor_ = formatLen_;
+        out_[len_] = '\0';
+        len = len_;
+        return out_;
+    }
+
+private:
+    void append(const char* data, size_t len) {
+        len = (std::min)(len, sizeof(out_) - 1 - len_);
+        memcpy(out_ + len_, data, len);
+        len_ += len;
+    }
+
+    char format_[MAX_USERMSG_SIZE];
+    char out_[MAX_USERMSG_SIZE + MAX_MESSAGE_ARGS + 1];
+    size_t formatLen_ = 0;
+    size_t cursor_ = 0;
+    size_t len_ = 0;
+};
+
+// Bounded reader over a copied SayText/TextMsg buffer, standing in for HLSDK's
+// BEGIN_READ/READ_*. Strings point into the buffer itself: the caller keeps one byte
+// past the end NUL, so an unterminated last string still ends inside it.
+class UserMsgReader {
+public:
+    UserMsgReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+    bool atEnd() const { return pos_ >= size_; }
+
+    // -1 past the end, like READ_BYTE
+    int readByte() {
+        return pos_ < size_ ? (unsigned char)data_[pos_++] : -1;
+    }
+
+    const char* readString() {
+        if (pos_ >= size_) {
+            return "";
+        }
+        const char* str = data_ + pos_;
+        const char* end = static_cast<const char*>(memchr(str, '\0', size_ - pos_));
+        pos_ = end ? (size_t)(end - data_) + 1 : size_;
+        return str;
+    }
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t pos_ = 0;
+};
+
+// Streaming line splitter for OutputDebugStringA output. A cursor walks each chunk with
+// memchr, and complete lines go to emit() straight out of the caller's string. Only an
+// unterminated tail is copied into partial_, and only until its newline arrives. The hook
+// keeps one assembler per thread, so concurrent loggers neither lock nor interleave
+// half lines. A partial line that reaches SYS_LINE_FLUSH bytes is flushed as is and the
+// rest of that run, up to its newline, is dropped.
+class LineAssembler {
+public:
+    template <typename Emit>
+    void feed(const char* text, size_t len, Emit&& emit) {
+        const char* end = text + len;
+        while (text < end) {
+            const char* newline = static_cast<const char*>(memchr(text, '\n', end - text));
+            if (!newline) {
+                if (dropping_) {
+                    return;
+                }
+                size_t take = (std::min)((size_t)(end - text), SYS_LINE_FLUSH - partialLen_);
+                memcpy(partial_ + partialLen_, text, take);
+                partialLen_ += take;
+                if (partialLen_ >= SYS_LINE_FLUSH) {
+                    emit(partial_, partialLen_);
+                    partialLen_ = 0;
+                    dropping_ = true;
+                }
+                return;
+            }
+
+            size_t lineLen = newline - text;
+            if (dropping_) {
+                dropping_ = false; // newline ends the overflowed run
+            }
+            else if (partialLen_ > 0) {
+                size_t take = (std::min)(lineLen, SYS_LINE_FLUSH - partialLen_);
+                memcpy(partial_ + partialLen_, text, take);
+                emitLine(partial_, partialLen_ + take, emit);
+                partialLen_ = 0;
+            }
+            else {
+                emitLine(text, lineLen, emit);
+            }
+            text = newline + 1;
+        }
+    }
+
+private:
+    template <typename Emit>
+    static void emitLine(const char* line, size_t len, Emit&& emit) {
+        if (len > 0 && line[len - 1] == '\r') {
+            len--;
+        }
+        emit(line, len);
+    }
+
+    char partial_[SYS_LINE_FLUSH];
+    size_t partialLen_ = 0;
+    bool dropping_ = false;
+};
+
+// Cross-stream duplicate suppression. Content is normalized the same way the test client's
+// _content_key does it (bytes below 0x20 dropped, surrounding spaces trimmed, ASCII lowercased)
+// and hashed on the fly. Each slot of the fixed open-addressing table packs hash and timestamp
+// into one 64-bit word, so lookups and inserts are single atomic loads/stores. Races between
+// producers can at worst let a duplicate through; they never drop distinct content.
+class DedupFilter {
+public:
+    bool isDuplicate(const char* data, size_t len, uint32_t windowMs) {
+        uint32_t hash = HashNormalized(data, len);
+        if (hash == 0) {
+            return false; // nothing left after normalization
+        }
+        uint32_t now = (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+
+        std::atomic<uint64_t>* victim = nullptr;
+        for (uint32_t i = 0; i < DEDUP_PROBES; i++) {
+            std::atomic<uint64_t>& slot = table_[(hash + i) & (DEDUP_TABLE_SIZE - 1)];
+            uint64_t entry = slot.load(std::memory_order_relaxed);
+            bool live = entry != 0 && now - (uint32_t)entry <= windowMs;
+            if (live && (uint32_t)(entry >> 32) == hash) {
+                hits_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            if (!live && !victim) {
+                victim = &slot;
+            }
+        }
+
+        if (!victim) {
+            victim = &table_[hash & (DEDUP_TABLE_SIZE - 1)];
+        }
+        victim->store(((uint64_t)hash << 32) | now, std::memory_order_relaxed);
+        return false;
+    }
+
+    size_t hits() const { return hits_.load(std::memory_order_relaxed); }
+
+private:
+    // FNV-1a over the normalized key. Spaces are held back until a non-space byte follows,
+    // which trims both ends without a second pass. Returns 0 for an empty key.
+    static uint32_t HashNormalized(const char* data, size_t len) {
+        uint32_t hash = 2166136261u;
+        size_t pendingSpaces = 0;
+        bool any = false;
+        for (size_t i = 0; i < len; i++) {
+            unsigned char c = (unsigned char)data[i];
+            if (c < 0x20) {
+                continue;
+            }
+            if (c == ' ') {
+                if (any) pendingSpaces++;
+                continue;
+            }
+            for (; pendingSpaces; pendingSpaces--) {
+                hash = (hash ^ ' ') * 16777619u;
+            }
+            if (c >= 'A' && c <= 'Z') {
+                c += 'a' - 'A';
+            }
+            hash = (hash ^ c) * 16777619u;
+            any = true;
+        }
+        return any ? (hash | 1) : 0;
+    }
+
+    std::atomic<uint64_t> table_[DEDUP_TABLE_SIZE] = {};
+    std::atomic<size_t> hits_{ 0 };
+};
+
+// cf_filter rules compiled into one Aho-Corasick automaton over case-folded bytes, with
+// the alphabet reduced to the bytes the patterns use. Checking an event is one table
+// lookup per byte, however many rules there are. Each node carries the tag masks of the
+// include/exclude rules that end at it or at any of its suffixes. Rule lists are only
+// walked on a hit, to bump its counter.
+// Per tag: an event matching an exclude rule is dropped; if the tag has include rules,
+// only events matching one of them are kept. Immutable once compiled, except the counters.
+class FilterSet {
+public:
+    struct Rule {
+        int tags = 0;          // bit 0 = CHAT ... bit 4 = STUFF
+        bool exclude = false;
+        std::string pattern;
+        mutable std::atomic<uint64_t> hits{ 0 };
+    };
+
+    // "<tags> <+|-> <pattern>": tags is * , a list like chat,net or a cf_dedup_tags mask;
+    // + includes, - excludes; the pattern is the rest of the line, matched without case.
+    // Blank lines and # comments are accepted and ignored.
+    bool addRule(const char* line, std::string& error);
+    void compile();
+
+    bool allows(char tag, const char* text, size_t len) const;
+
+    size_t size() const { return rules_.size(); }
+    const Rule& rule(size_t index) const { return rules_[index]; }
+
+private:
+    struct Node {
+        int excludeTags = 0;
+        int includeTags = 0;
+        int32_t firstRule = -1;    // rules ending exactly here, chained through ruleNext_
+        int32_t outLink = 0;       // nearest proper suffix with rules of its own; 0 = none
+    };
+
+    std::deque<Rule> rules_;
+    std::vector<int32_t> ruleNext_;
+    std::vector<Node> nodes_;
+    std::vector<int32_t> next_;    // node * classes_ + class -> node
+    unsigned char classOf_[256] = {};
+    int classes_ = 1;
+    int includeTags_ = 0;          // tags with at least one include rule
+    int excludeTags_ = 0;          // tags with at least one exclude rule
+    int ruleTags_ = 0;             // tags with any rule at all
+};
+
+// Publishes the compiled FilterSet like ConfigStore publishes snapshots: an atomic pointer
+// readers load once per event, with replaced sets retired rather than freed.
+class FilterStore {
+public:
+    const FilterSet* current() const {
+        return current_.load(std::memory_order_acquire);
+    }
+
+    // Game thread only
+    void publish(std::unique_ptr<FilterSet> set) {
+        current_.store(set.get(), std::memory_order_release);
+        retired_.push_back(std::move(set));
+    }
+
+private:
+    std::atomic<const FilterSet*> current_{ nullptr };
+    std::vector<std::unique_ptr<FilterSet>> retired_;
+};
+
+// Who asked for a command's output, from a REQUEST_MAGIC envelope; id 0 = nobody
+struct CommandRequest {
+    uint32_t id = 0;
+    sockaddr_in replyTo = {};
+};
+
+// Inbound commands waiting for HUD_Frame, wait-free for its one producer (the reactor)
+// and one consumer (the game thread). A byte ring of [uint32 length][uint32 request id]
+// [int64 received][sockaddr_in reply address][text] records, padded to 8 bytes. Each side
+// owns one index and publishes it with a release store, so checking for work is a single
+// acquire load. A WRAP_MARK length sends the
+// reader back to the start of the buffer.
+class CommandRing {
+public:
+    // Producer only. False if the ring has no room for the command.
+    bool push(const char* text, size_t len, int64_t received, const CommandRequest& request) {
+        const uint32_t need = Align(HEADER_SIZE + (uint32_t)len);
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t used = head - tail_.load(std::memory_order_acquire);
+        uint32_t offset = head & (COMMAND_RING_BYTES - 1);
+        uint32_t pad = offset + need > COMMAND_RING_BYTES ? (uint32_t)COMMAND_RING_BYTES - offset : 0;
+        if (used + pad + need > COMMAND_RING_BYTES) {
+            return false;
+        }
+        if (pad) {
+            memcpy(buffer_ + offset, &WRAP_MARK, sizeof(WRAP_MARK));
+            offset = 0;
+        }
+        uint32_t length = (uint32_t)len;
+        memcpy(buffer_ + offset, &length, sizeof(length));
+        memcpy(buffer_ + offset + 4, &request.id, sizeof(request.id));
+        memcpy(buffer_ + offset + 8, &received, sizeof(received));
+        memcpy(buffer_ + offset + 16, &request.replyTo, sizeof(request.replyTo));
+        memcpy(buffer_ + offset + HEADER_SIZE, text, len);
+        head_.store(head + pad + need, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only
+    bool pop(std::string& text, int64_t* received, CommandRequest* request = nullptr) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        uint32_t offset = tail & (COMMAND_RING_BYTES - 1);
+        uint32_t length;
+        memcpy(&length, buffer_ + offset, sizeof(length));
+        if (length == WRAP_MARK) {
+            tail += (uint32_t)COMMAND_RING_BYTES - offset;
+            offset = 0;
+            memcpy(&length, buffer_, sizeof(length));
+        }
+        if (received) {
+            memcpy(received, buffer_ + offset + 8, sizeof(*received));
+        }
+        if (request) {
+            memcpy(&request->id, buffer_ + offset + 4, sizeof(request->id));
+            memcpy(&request->replyTo, buffer_ + offset + 16, sizeof(request->replyTo));
+        }
+        text.assign(buffer_ + offset + HEADER_SIZE, length);
+        tail_.store(tail + Align(HEADER_SIZE + length), std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only
+    bool empty() const {
+        return tail_.load(std::memory_order_relaxed) == head_.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr uint32_t HEADER_SIZE = 32;
+    static_assert(sizeof(sockaddr_in) == 16, "the reply address takes 16 header bytes");
+    static constexpr uint32_t WRAP_MARK = 0xFFFFFFFFu;
+    static_assert((COMMAND_RING_BYTES & (COMMAND_RING_BYTES - 1)) == 0, "ring size must be a power of two");
+
+    static uint32_t Align(uint32_t size) { return (size + 7) & ~7u; }
+
+    alignas(8) char buffer_[COMMAND_RING_BYTES];
+    alignas(64) std::atomic<uint32_t> head_{ 0 };   // written by the producer
+    alignas(64) std::atomic<uint32_t> tail_{ 0 };   // written by the consumer
+};
+
+// Inbound command queue with an urgent lane that is always drained first. push() is for
+// the reactor only and pop() for the game thread only; neither locks.
+class MessageQueue {
+public:
+    // received is the MonotonicTicks() arrival time, handed back by pop()
+    bool push(const char* text, size_t len, bool urgent = false, int64_t received = 0,
+        const CommandRequest& request = CommandRequest()) {
+        if (shutdown_.load(std::memory_order_relaxed) || size() >= MAX_QUEUE_SIZE ||
+            !(urgent ? urgent_ : queue_).push(text, len, received, request)) {
+            return false;
+        }
+        pushed_.fetch_add(1, std::memory_order_relaxed);
+        uint32_t depth = (uint32_t)size();
+        if (depth > g_stats.commandHighWater.load(std::memory_order_relaxed)) {
+            g_stats.commandHighWater.store(depth, std::memory_order_relaxed);
+        }
+        return true;
+    }
+    // Pops the oldest urgent command, or the oldest normal one unless urgentOnly is set.
+    bool pop(std::string& msg, bool& urgent, bool urgentOnly = false, int64_t* received = nullptr,
+        CommandRequest* request = nullptr) {
+        if (shutdown_.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        urgent = urgent_.pop(msg, received, request);
+        if (!urgent && (urgentOnly || !queue_.pop(msg, received, request))) {
+            return false;
+        }
+        popped_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    void shutdown() {
+        shutdown_.store(true, std::memory_order_release);
+    }
+    // Game thread only
+    void clear() {
+        std::string msg;
+        bool urgent;
+        while (pop(msg, urgent)) {}
+    }
+    // Any thread; a snapshot that may be one command off while both sides are busy
+    size_t size() const {
+        size_t pushed = pushed_.load(std::memory_order_relaxed);
+        size_t popped = popped_.load(std::memory_order_relaxed);
+        return pushed > popped ? pushed - popped : 0;
+    }
+private:
+    CommandRing queue_;
+    CommandRing urgent_;
+    std::atomic<size_t> pushed_{ 0 };
+    std::atomic<size_t> popped_{ 0 };
+    std::atomic<bool> shutdown_{ false };
+};
+
+// Command replies built on the game thread and sent by the reactor from cf_listen_port,
+// so they come back from the port the request went to. pending() is a single load.
+class ReplyQueue {
+public:
+    struct Reply {
+        std::string datagram;
+        sockaddr_in to;
+    };
+
+    void push(std::string datagram, const sockaddr_in& to) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (replies_.size() < MAX_PENDING_REPLIES) {
+            replies_.push_back(Reply{ std::move(datagram), to });
+            pending_.store(true, std::memory_order_release);
+        }
+    }
+
+    bool pending() const { return pending_.load(std::memory_order_acquire); }
+
+    // Reactor thread
+    void take(std::vector<Reply>& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        out.swap(replies_);
+        replies_.clear();
+        pending_.store(false, std::memory_order_relaxed);
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<Reply> replies_;
+    std::atomic<bool> pending_{ false };
+};
+
+// Paces inbound command execution in HUD_Frame: at most commandsPerFrame commands and
+// frameBudgetUs microseconds per frame, with a token bucket (rate/s, burst) on top.
+// Urgent commands skip the bucket but still count against the per-frame budget.
+// A request (a command with a reply id) runs alone: console text printed on the game thread
+// from then on is its output, until none arrived for cf_cmd_reply_ms or COMMAND_REPLY_MAX_MS
+// passed. The window spans frames, so answers from the server are caught as well. Nothing
+// else runs meanwhile.
+// Game thread only, except capture().
+class CommandScheduler {
+public:
+    typedef std::chrono::steady_clock::time_point (*Clock)();
+
+    // The budgets and the bucket run on clock; tests pass a fake one
+    explicit CommandScheduler(Clock clock = std::chrono::steady_clock::now) : clock_(clock) {}
+
+    void runFrame(const ConfigSnapshot& cfg);
+
+    // Any thread; keeps text printed on the game thread while a request's output is collected
+    void capture(const char* text, size_t len);
+
+    double tokens() const { return tokens_; }
+    long long lastFrameUs() const { return lastFrameUs_; }
+    long long maxFrameUs() const { return maxFrameUs_; }
+    int lastFrameCommands() const { return lastFrameCommands_; }
+    size_t executed() const { return executed_; }
+    size_t replies() const { return replies_; }
+    // Any thread; true while a request's output window is open
+    bool capturing() const { return capturing_.load(std::memory_order_relaxed); }
+
+private:
+    struct Held {
+        std::string text;
+        bool urgent = false;
+        int64_t received = 0;
+        CommandRequest request;
+    };
+
+    // Sends the reply once the output window is over; false while it is still open
+    bool finishRequest(const ConfigSnapshot& cfg);
+
+    double tokens_ = 0.0;
+    bool primed_ = false;
+    Clock clock_;
+    std::chrono::steady_clock::time_point lastRefill_;
+    long long lastFrameUs_ = 0;
+    long long maxFrameUs_ = 0;
+    int lastFrameCommands_ = 0;
+    size_t executed_ = 0;
+    size_t replies_ = 0;
+
+    bool hasHeld_ = false;
+    Held held_;                                // a request popped behind other commands
+    CommandRequest request_;                   // the request whose output is being collected
+    int64_t requestReceived_ = 0;
+    int64_t requestRun_ = 0;
+    int64_t lastOutput_ = 0;
+    std::string output_;
+    bool truncated_ = false;
+    std::atomic<bool> capturing_{ false };
+    std::atomic<std::thread::id> gameThread_{};
+};
+
+// Core globals
+extern MessageQueue g_messageQueue;
+extern SendQueue g_sendQueue;
+extern DestinationCache g_destination;
+extern DedupFilter g_dedup;
+extern FilterStore g_filters;
+extern ConfigStore g_config;
+extern NackQueue g_nacks;
+extern ReplyQueue g_replies;
+extern Spool g_spool;
+extern CommandScheduler g_commandScheduler;
+
+extern std::atomic<bool> g_shutdownReactor;
+
+// Lifecycle. Forwarder_Init allocates the send queue and publishes the first config; call it
+// once the engine shim can read cvars. Forwarder_Shutdown signals the reactor to return
+// and stops the hostname resolver thread.
+bool Forwarder_Init(void);
+void Forwarder_Shutdown(void);
+
+// Engine-neutral hook bodies. The adapter chains to the engine's original handler afterwards.
+void Forwarder_SayText(const void* buf, int size);
+void Forwarder_TextMsg(const void* buf, int size);
+void Forwarder_NetPrint(const char* text);        // cl_parsefunc "print"
+void Forwarder_StuffText(const char* text);       // cl_parsefunc "stufftext"
+void Forwarder_DebugString(const char* text);     // OutputDebugStringA
+void Forwarder_ConPrint(const char* text);        // Con_Printf: only collects command request output
+void Forwarder_Frame(void);                       // HUD_Frame: config refresh, command pacing
+// Sender side of cf_deferred: decodes up to CAPTURE_BATCH captured hook inputs into the lanes
+void Forwarder_DecodeCaptures(void);
+
+// The one work item: sends, receives and runs the flush/stats/replay timers until
+// Forwarder_Shutdown
+bool ReactorWorkCallback(void* ctx);
+
+// What a SayText/TextMsg event carries besides its expanded text, for cf_encoding 1.
+// The strings point into the raw user message and are cleaned as they are encoded.
+struct EventFields {
+    int client = -1;
+    int dest = -1;
+    const char* key = nullptr;
+    const char* args[MAX_MESSAGE_ARGS] = {};
+    int argCount = 0;
+};
+
+// cf_filter, dedup, then push to the tag's lane; stamp is the hook's ProfileNow(), or 0 for now.
+// With cf_encoding 1 the event is queued as a structured body built from text and fields.
+void QueueTask(char tag, const char* msg, size_t len, int64_t stamp, const EventFields* fields = nullptr);
+void RefreshConfig(void);
+size_t CleanMessage(const char* input, size_t len, char* out);
+size_t CleanMessageScalar(const char* input, size_t len, char* out);
+#if CF_HAVE_SSE2
+size_t CleanMessageSSE2(const char* input, size_t len, char* out);
+#endif
+#if CF_HAVE_AVX2
+size_t CleanMessageAVX2(const char* input, size_t len, char* out);
+#endif
+
+void Cmd_DedupStats(void);
+void Cmd_CommandStats(void);
+void Cmd_Stats(void);
+void Cmd_Latency(void);
+void Cmd_SpoolReplay(void);
+void Cmd_DestAdd(void);
+void Cmd_DestRemove(void);
+void Cmd_DestList(void);
+void Cmd_FilterReload(void);
+void Cmd_FilterStats(void);
+
+#endif // CF_FORWARDER_H
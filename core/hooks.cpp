@@ -0,0 +1,393 @@
+// hooks.cpp
+// Game-thread side of the core: what each engine hook forwards, and HUD_Frame command pacing.
+// With cf_deferred the hooks only capture their raw input and the same decoders run on the sender.
+#include "forwarder.h"
+
+// Numbers structured events in the order they are queued, across all hook threads
+static std::atomic<uint64_t> g_eventSequence(0);
+
+static int64_t TicksToUs(int64_t ticks) {
+    static const int64_t frequency = MonotonicFrequency();
+    return ticks > 0 ? ticks / frequency * 1000000 + ticks % frequency * 1000000 / frequency : 0;
+}
+
+// Wall-clock microseconds at stamp (a ProfileNow() time), or now if there is none
+static uint64_t CaptureTimeUs(int64_t stamp) {
+    int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    if (stamp) {
+        now -= TicksToUs(MonotonicTicks() - stamp);
+    }
+    return (uint64_t)(std::max)(now, (int64_t)0);
+}
+
+static void EncodeEvent(EventEncoder& encoder, const char* msg, size_t len, int64_t stamp, const EventFields* fields) {
+    encoder.reset();
+    encoder.addInt(EVENT_TIME, CaptureTimeUs(stamp));
+    encoder.addInt(EVENT_SEQ, g_eventSequence.fetch_add(1, std::memory_order_relaxed) + 1);
+    if (!fields) {
+        encoder.addString(EVENT_TEXT, msg, len);
+        return;
+    }
+    if (fields->client >= 0) {
+        encoder.addInt(EVENT_CLIENT, (uint64_t)fields->client);
+    }
+    if (fields->dest >= 0) {
+        encoder.addInt(EVENT_DEST, (uint64_t)fields->dest);
+    }
+    // Key and arguments share the user message's bytes, so together they fit the record
+    encoder.addCleaned(EVENT_KEY, fields->key, strnlen(fields->key, MAX_USERMSG_SIZE));
+    for (int i = 0; i < fields->argCount; i++) {
+        encoder.addCleaned(EVENT_ARG, fields->args[i], strnlen(fields->args[i], MAX_USERMSG_SIZE));
+    }
+}
+
+void QueueTask(char tag, const char* msg, size_t len, int64_t stamp, const EventFields* fields) {
+    if (len == 0) return;
+
+    // cf_filter rules run first, so a filtered event costs one scan and nothing else
+    const ConfigSnapshot& cfg = g_config.current();
+    if (cfg.filter) {
+        const FilterSet* filter = g_filters.current();
+        if (filter && !filter->allows(tag, msg, len)) {
+            ForwarderStats::Add(g_stats.lanes[SendQueue::LaneOf(tag)].dropped[DROP_FILTERED]);
+            return;
+        }
+    }
+    // Optional cross-stream dedup; cf_dedup_tags bit 0 = CHAT ... bit 4 = STUFF
+    if (cfg.dedup && (cfg.dedupTags & (1 << (tag - MSG_TYPE_CHAT))) &&
+        g_dedup.isDuplicate(msg, len, cfg.dedupWindowMs)) {
+        ForwarderStats::Add(g_stats.lanes[SendQueue::LaneOf(tag)].dropped[DROP_DUPLICATE]);
+        return;
+    }
+    // Filter and dedup look at the text either way; only what goes on the wire differs
+    if (cfg.encoding == 1) {
+        // Sized for the largest record, so kept off the stack
+        static thread_local EventEncoder encoder;
+        EncodeEvent(encoder, msg, len, stamp, fields);
+        tag |= MSG_STRUCTURED_FLAG;
+        msg = encoder.data();
+        len = encoder.size();
+    }
+    // A full lane spills into cf_spool instead of dropping the event
+    if (!g_sendQueue.push(tag, msg, len, stamp ? stamp : ProfileNow()) && cfg.spool &&
+        g_spool.append(tag, msg, len)) {
+        ForwarderStats::Add(g_stats.spooled);
+    }
+}
+
+// Where an event is decoded: in the hook itself, or on the sender from a capture
+struct DecodeContext {
+    bool echo;          // cf_debug echo; Con_Printf is only safe on the game thread
+    int64_t stamp;      // capture time, or 0 to stamp the event when it is queued
+};
+
+// print / stufftext carry one string, forwarded as is after cleaning
+static void DecodeString(char tag, const char* label, const char* text, size_t len, const DecodeContext& ctx) {
+    char cleanMsg[MAX_MESSAGE_STRING + 1];
+    size_t cleanLen = CleanMessage(text, len, cleanMsg);
+    if (cleanLen > 0) {
+        if (ctx.echo) {
+            g_engine.Con_Printf("[ChatForwarder][%s] %s", label, cleanMsg);
+        }
+        QueueTask(tag, cleanMsg, cleanLen, ctx.stamp);
+    }
+}
+
+// Expands the format string and the (up to four) %s arguments that follow it. fields
+// collects the same strings, empty arguments included, for cf_encoding 1.
+static void ForwardFormatted(char tag, const char* label, UserMsgReader& reader, EventFields& fields,
+    const DecodeContext& ctx) {
+    // Sized for the largest user message, so kept off the stack
+    static thread_local MessageExpander expander;
+    fields.key = reader.readString();
+    expander.begin(fields.key);
+    for (int i = 0; i < MAX_MESSAGE_ARGS && !reader.atEnd(); i++) {
+        const char* arg = reader.readString();
+        fields.args[fields.argCount++] = arg;
+        if (arg[0]) {
+            expander.addArg(arg);
+        }
+    }
+
+    size_t len;
+    const char* fullMsg = expander.finish(len);
+    if (len > 0) {
+        if (ctx.echo) {
+            g_engine.Con_Printf("[ChatForwarder][%s] %s\n", label, fullMsg);
+        }
+        QueueTask(tag, fullMsg, len, ctx.stamp, &fields);
+    }
+}
+
+// User message decoders; buf holds size raw bytes followed by a NUL
+static void DecodeSayText(char* buf, int size, const DecodeContext& ctx) {
+    UserMsgReader reader(buf, size);
+    EventFields fields;
+    fields.client = reader.readByte();
+    ForwardFormatted(MSG_TYPE_CHAT, "CHAT", reader, fields, ctx);
+}
+
+static void DecodeTextMsg(char* buf, int size, const DecodeContext& ctx) {
+    UserMsgReader reader(buf, size);
+    EventFields fields;
+    fields.dest = reader.readByte();
+    if (fields.dest >= 1 && fields.dest <= 4) {
+        ForwardFormatted(MSG_TYPE_GAME, "GAME", reader, fields, ctx);
+    }
+}
+
+static void DecodeSysLine(const char* line, size_t len, const DecodeContext& ctx) {
+    char cleanMsg[SYS_LINE_FLUSH + 1];
+    size_t cleanLen = CleanMessage(line, (std::min)(len, SYS_LINE_FLUSH), cleanMsg);
+    if (cleanLen > 0) {
+        QueueTask(MSG_TYPE_SYS, cleanMsg, cleanLen, ctx.stamp);
+    }
+}
+
+static void ForwardString(char tag, const char* label, const char* psz) {
+    if (psz && psz[0]) {
+        size_t len = strnlen(psz, MAX_MESSAGE_STRING);
+        const ConfigSnapshot& cfg = g_config.current();
+        if (cfg.deferred) {
+            g_sendQueue.capture(tag, psz, len, ProfileNow());
+            return;
+        }
+        DecodeString(tag, label, psz, len, DecodeContext{ cfg.debug, 0 });
+    }
+}
+
+void Forwarder_NetPrint(const char* text) {
+    CF_PROFILE_HOOK(hookTimer, MSG_TYPE_NET);
+    ForwardString(MSG_TYPE_NET, "NET", text);
+}
+
+void Forwarder_StuffText(const char* text) {
+    CF_PROFILE_HOOK(hookTimer, MSG_TYPE_STUFF);
+    ForwardString(MSG_TYPE_STUFF, "STUFF", text);
+}
+
+// User messages past MAX_USERMSG_SIZE are parsed up to the cut; the last string ends there
+static void ForwardUserMsg(char tag, const void* buf, int size, void (*decode)(char*, int, const DecodeContext&)) {
+    if (size < 0) return;
+    size = (std::min)(size, (int)MAX_USERMSG_SIZE);
+
+    const ConfigSnapshot& cfg = g_config.current();
+    if (cfg.deferred) {
+        g_sendQueue.capture(tag, static_cast<const char*>(buf), size, ProfileNow());
+        return;
+    }
+    char temp_buf[MAX_USERMSG_SIZE + 1];
+    memcpy(temp_buf, buf, size);
+    temp_buf[size] = '\0';
+    decode(temp_buf, size, DecodeContext{ cfg.debug, 0 });
+}
+
+void Forwarder_SayText(const void* buf, int size) {
+    CF_PROFILE_HOOK(hookTimer, MSG_TYPE_CHAT);
+    if (g_config.current().enabled) {
+        ForwardUserMsg(MSG_TYPE_CHAT, buf, size, DecodeSayText);
+    }
+}
+
+void Forwarder_TextMsg(const void* buf, int size) {
+    CF_PROFILE_HOOK(hookTimer, MSG_TYPE_GAME);
+    if (g_config.current().enabled) {
+        ForwardUserMsg(MSG_TYPE_GAME, buf, size, DecodeTextMsg);
+    }
+}
+
+void Forwarder_DebugString(const char* text) {
+    if (!text || !text[0]) return;
+    CF_PROFILE_HOOK(hookTimer, MSG_TYPE_SYS);
+
+    const ConfigSnapshot& cfg = g_config.current();
+    if (cfg.enabled) {
+        // Lines are assembled here in both modes: partial lines belong to the calling thread
+        static thread_local LineAssembler assembler;
+        if (cfg.deferred) {
+            assembler.feed(text, strlen(text), [](const char* line, size_t len) {
+                if (len > 0) {
+                    g_sendQueue.capture(MSG_TYPE_SYS, line, len, ProfileNow());
+                }
+            });
+        }
+        else {
+            assembler.feed(text, strlen(text), [](const char* line, size_t len) {
+                DecodeSysLine(line, len, DecodeContext{ false, 0 });
+            });
+        }
+    }
+}
+
+void Forwarder_DecodeCaptures(void) {
+    char raw[MAX_CAPTURE_SIZE + 1];
+    size_t len;
+    int64_t stamp = 0;
+    for (int i = 0; i < CAPTURE_BATCH && g_sendQueue.takeCapture(raw, MAX_CAPTURE_SIZE, len, &stamp); i++) {
+        raw[len] = '\0';
+        char* body = raw + 1;
+        DecodeContext ctx{ false, stamp };
+        switch (raw[0]) {
+        case MSG_TYPE_CHAT: DecodeSayText(body, (int)(len - 1), ctx); break;
+        case MSG_TYPE_GAME: DecodeTextMsg(body, (int)(len - 1), ctx); break;
+        case MSG_TYPE_NET: DecodeString(MSG_TYPE_NET, "NET", body, len - 1, ctx); break;
+        case MSG_TYPE_STUFF: DecodeString(MSG_TYPE_STUFF, "STUFF", body, len - 1, ctx); break;
+        case MSG_TYPE_SYS: DecodeSysLine(body, len - 1, ctx); break;
+        }
+    }
+}
+
+void CommandScheduler::capture(const char* text, size_t len) {
+    if (!capturing_.load(std::memory_order_acquire) ||
+        gameThread_.load(std::memory_order_relaxed) != std::this_thread::get_id()) {
+        return;
+    }
+    size_t room = MAX_REPLY_SIZE - REPLY_HEADER_SIZE - output_.size();
+    if (len > room) {
+        len = room;
+        truncated_ = true;
+    }
+    size_t at = output_.size();
+    output_.resize(at + len + 1);
+    output_.resize(at + CleanMessage(text, len, &output_[at]));
+    lastOutput_ = MonotonicTicks();
+}
+
+// The engine's print handler (svc_print) ends in Con_Printf too, so server answers land here
+void Forwarder_ConPrint(const char* text) {
+    if (text) {
+        g_commandScheduler.capture(text, strnlen(text, MAX_MESSAGE_STRING));
+    }
+}
+
+bool CommandScheduler::finishRequest(const ConfigSnapshot& cfg) {
+    int64_t now = MonotonicTicks();
+    if (TicksToUs(now - lastOutput_) < (int64_t)cfg.commandReplyMs * 1000 &&
+        TicksToUs(now - requestRun_) < (int64_t)COMMAND_REPLY_MAX_MS * 1000) {
+        return false;
+    }
+    capturing_.store(false, std::memory_order_relaxed);
+
+    auto putU32 = [](std::string& out, uint32_t value) {
+        for (int i = 0; i < 4; i++) out += (char)(value >> (8 * i));
+    };
+    std::string reply(1, (char)REQUEST_MAGIC);
+    putU32(reply, request_.id);
+    reply += (char)(truncated_ ? REPLY_TRUNCATED : 0);
+    putU32(reply, (uint32_t)(std::min)(TicksToUs(requestRun_ - requestReceived_), (int64_t)UINT32_MAX));
+    putU32(reply, (uint32_t)(std::min)(TicksToUs(now - requestRun_), (int64_t)UINT32_MAX));
+    reply += output_;
+    g_replies.push(std::move(reply), request_.replyTo);
+    g_sendQueue.wake();
+    replies_++;
+    return true;
+}
+
+void CommandScheduler::runFrame(const ConfigSnapshot& cfg) {
+    auto start = clock_();
+    if (capturing_.load(std::memory_order_relaxed) && !finishRequest(cfg)) {
+        lastFrameCommands_ = 0;
+        lastFrameUs_ = 0;
+        return;
+    }
+
+    // Refill the bucket; a rate of 0 means unlimited
+    if (!primed_) {
+        tokens_ = cfg.commandBurst;
+        primed_ = true;
+    }
+    else if (cfg.commandRate > 0.0) {
+        double elapsed = std::chrono::duration<double>(start - lastRefill_).count();
+        tokens_ = (std::min)(tokens_ + elapsed * cfg.commandRate, cfg.commandBurst);
+    }
+    else {
+        tokens_ = cfg.commandBurst;
+    }
+    lastRefill_ = start;
+
+    int count = 0;
+    std::string message;
+    bool urgent = false;
+    int64_t received = 0;
+    CommandRequest request;
+    while (count < cfg.commandsPerFrame) {
+        if (cfg.commandFrameUs > 0 && count > 0 &&
+            clock_() - start >= std::chrono::microseconds(cfg.commandFrameUs)) {
+            break;
+        }
+        if (hasHeld_) {
+            // Already admitted by the bucket last frame
+            message.swap(held_.text);
+            urgent = held_.urgent;
+            received = held_.received;
+            request = held_.request;
+            hasHeld_ = false;
+        }
+        else {
+            bool limited = cfg.commandRate > 0.0 && tokens_ < 1.0;
+            if (!g_messageQueue.pop(message, urgent, limited, &received, &request)) {
+                break;
+            }
+            if (!urgent && cfg.commandRate > 0.0) {
+                tokens_ -= 1.0;
+            }
+        }
+        if (request.id && count > 0) {
+            // A request runs alone, so output of this frame's other commands stays out of its reply
+            held_.text.swap(message);
+            held_.urgent = urgent;
+            held_.received = received;
+            held_.request = request;
+            hasHeld_ = true;
+            break;
+        }
+        while (!message.empty() && (unsigned char)message.back() <= 32) {
+            message.pop_back();
+        }
+        if (message.empty()) {
+            continue;
+        }
+
+        if (cfg.debug) {
+            g_engine.Con_Printf("[ChatForwarder] Executing%s: %s\n", urgent ? " (urgent)" : "", message.c_str());
+        }
+        message += '\n';
+        g_engine.ClientCmd(message.c_str());
+#if CF_PROFILER
+        g_profiler.commandWait.record(LatencyProfiler::ToNs(ProfileNow() - received));
+#endif
+        count++;
+        if (request.id) {
+            // Output is collected until the engine ran it; see finishRequest()
+            request_ = request;
+            requestReceived_ = received;
+            requestRun_ = lastOutput_ = MonotonicTicks();
+            output_.clear();
+            truncated_ = false;
+            gameThread_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+            capturing_.store(true, std::memory_order_release);
+            break;
+        }
+    }
+
+    if (count > 0) {
+        executed_ += count;
+        ForwarderStats::Add(g_stats.commandsExecuted, count);
+        lastFrameUs_ = std::chrono::duration_cast<std::chrono::microseconds>(
+            clock_() - start).count();
+        maxFrameUs_ = (std::max)(maxFrameUs_, lastFrameUs_);
+    }
+    else {
+        lastFrameUs_ = 0;
+    }
+    lastFrameCommands_ = count;
+}
+
+void Forwarder_Frame(void) {
+#if CF_PROFILER
+    g_profiler.endFrame();
+#endif
+    RefreshConfig();
+    g_commandScheduler.runFrame(g_config.current());
+}
@@ -0,0 +1,186 @@
+// platform.h
+// The only OS surface of the core: UDP sockets, a wakeable event, a monotonic clock and
+// memory-mapped files for the cf_spool log.
+// platform_win32.cpp implements it on Winsock, platform_posix.cpp on BSD sockets + poll.
+#ifndef CF_PLATFORM_H
+#define CF_PLATFORM_H
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _WIN32
+typedef SOCKET NativeSocket;
+typedef HANDLE NativeWaitHandle;
+#else
+typedef int NativeSocket;
+typedef int NativeWaitHandle;      // read end of a self-pipe
+#endif
+
+// Owns the process-wide socket runtime (WSAStartup on Windows, nothing on POSIX)
+class SocketRuntime {
+public:
+    SocketRuntime();
+    ~SocketRuntime();
+    SocketRuntime(const SocketRuntime&) = delete;
+    SocketRuntime& operator=(const SocketRuntime&) = delete;
+
+    bool IsInitialized() const { return initialized_; }
+
+private:
+    bool initialized_ = false;
+};
+
+// Auto-reset event used to wake a blocked work item (new data, config change, shutdown).
+class WakeEvent {
+public:
+    WakeEvent();
+    ~WakeEvent();
+    WakeEvent(const WakeEvent&) = delete;
+    WakeEvent& operator=(const WakeEvent&) = delete;
+
+    void set();
+
+    // timeout_ms < 0 waits forever. Returns true if the event was signaled.
+    bool wait(int timeout_ms);
+
+    NativeWaitHandle handle() const;
+
+private:
+#ifdef _WIN32
+    HANDLE handle_;
+#else
+    int fds_[2];
+#endif
+};
+
+enum SocketWait {
+    SOCKET_READABLE,
+    SOCKET_WOKEN,        // the wake event fired; it has been reset
+    SOCKET_TIMEOUT,
+    SOCKET_WAIT_FAILED
+};
+
+enum SocketRecv {
+    RECV_OK,
+    RECV_WOULD_BLOCK,    // nothing left to read
+    RECV_SKIPPED,        // oversized datagram or ICMP error; try the next one
+    RECV_ERROR
+};
+
+// IPv4 UDP socket. Closed on destruction.
+class UdpSocket {
+public:
+    UdpSocket() = default;
+    ~UdpSocket() { close(); }
+    UdpSocket(const UdpSocket&) = delete;
+    UdpSocket& operator=(const UdpSocket&) = delete;
+
+    bool open();
+    void close();
+    bool valid() const;
+
+    // Binds INADDR_ANY:port with SO_REUSEADDR; port 0 picks an ephemeral one
+    bool bind(int port);
+    int localPort() const;
+
+    bool sendTo(const char* data, size_t len, const sockaddr_in& addr);
+
+    // SO_RCVBUF; the OS may clamp it (net.core.rmem_max on Linux)
+    bool setReceiveBuffer(int bytes);
+
+    // Switches the socket to non-blocking reads. Required before recv()/waitReadable().
+    bool watch();
+
+    // Blocks until a datagram is readable, wake is set or timeout_ms (< 0 = forever) passes.
+    // A readable socket wins over a simultaneously set wake event.
+    SocketWait waitReadable(WakeEvent& wake, int timeout_ms = -1);
+
+    // from, if given, receives the sender's address
+    SocketRecv recv(char* buffer, size_t size, size_t& len, sockaddr_in* from = nullptr);
+
+private:
+#ifdef _WIN32
+    NativeSocket sock_ = INVALID_SOCKET;
+    WSAEVENT event_ = WSA_INVALID_EVENT;
+#else
+    NativeSocket sock_ = -1;
+#endif
+};
+
+// Parses a dotted quad and port into an IPv4 address; never touches the resolver
+inline bool ParseAddress(const char* host, int port, sockaddr_in& addr) {
+    if (!host[0] || port <= 0 || port > 65535) {
+        return false;
+    }
+    addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+    return inet_pton(AF_INET, host, &addr.sin_addr) == 1;
+}
+
+// Resolves host (dotted quad or hostname) and port into an IPv4 address. A hostname goes
+// through getaddrinfo, which blocks.
+inline bool ResolveAddress(const char* host, int port, sockaddr_in& addr) {
+    if (ParseAddress(host, port, addr)) {
+        return true;
+    }
+    if (!host[0] || port <= 0 || port > 65535) {
+        return false;
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host, nullptr, &hints, &result) != 0 || !result) {
+        return false;
+    }
+    addr.sin_addr = reinterpret_cast<const sockaddr_in*>(result->ai_addr)->sin_addr;
+    freeaddrinfo(result);
+    return true;
+}
+
+// Shared read-write mapping of a whole file. Stores reach the file through the page cache:
+// no syscall and no flush per write. Unmapped on destruction.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps path at exactly size bytes. create makes a missing file and resizes an existing one
+    // (new bytes read as zero); without it, a missing file or one of another size fails.
+    bool open(const char* path, size_t size, bool create);
+    void close();
+
+    char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Creates one directory level; an existing directory counts as success
+bool MakeDirectory(const char* path);
+bool RemoveFile(const char* path);
+// Removes a directory that holds no files (RemoveDirectory is a Win32 macro)
+bool RemoveEmptyDirectory(const char* path);
+
+// Monotonic high-resolution clock: QPC ticks on Windows, nanoseconds on POSIX
+int64_t MonotonicTicks();
+int64_t MonotonicFrequency();
+
+#endif // CF_PLATFORM_H
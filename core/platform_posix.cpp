@@ -0,0 +1,215 @@
+// platform_posix.cpp
+// BSD sockets backend for Linux and other POSIX systems
+#include "platform.h"
+
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SocketRuntime::SocketRuntime() : initialized_(true) {}
+
+SocketRuntime::~SocketRuntime() {}
+
+static bool SetNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// Self-pipe: set() writes a byte, wait() drains them all, so repeated set() calls
+// collapse into one wake like an auto-reset event
+WakeEvent::WakeEvent() {
+    fds_[0] = fds_[1] = -1;
+    if (pipe(fds_) == 0) {
+        SetNonBlocking(fds_[0]);
+        SetNonBlocking(fds_[1]);
+        fcntl(fds_[0], F_SETFD, FD_CLOEXEC);
+        fcntl(fds_[1], F_SETFD, FD_CLOEXEC);
+    }
+}
+
+WakeEvent::~WakeEvent() {
+    if (fds_[0] >= 0) ::close(fds_[0]);
+    if (fds_[1] >= 0) ::close(fds_[1]);
+}
+
+void WakeEvent::set() {
+    const char signal = 1;
+    // A full pipe already means "signaled"
+    ssize_t ignored = write(fds_[1], &signal, 1);
+    (void)ignored;
+}
+
+bool WakeEvent::wait(int timeout_ms) {
+    pollfd pfd = { fds_[0], POLLIN, 0 };
+    int ready;
+    do {
+        ready = poll(&pfd, 1, timeout_ms < 0 ? -1 : timeout_ms);
+    } while (ready < 0 && errno == EINTR);
+    if (ready <= 0) {
+        return false;
+    }
+    char drain[64];
+    while (read(fds_[0], drain, sizeof(drain)) > 0) {}
+    return true;
+}
+
+NativeWaitHandle WakeEvent::handle() const {
+    return fds_[0];
+}
+
+bool UdpSocket::open() {
+    close();
+    sock_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock_ >= 0) {
+        fcntl(sock_, F_SETFD, FD_CLOEXEC);
+    }
+    return sock_ >= 0;
+}
+
+void UdpSocket::close() {
+    if (sock_ >= 0) {
+        ::close(sock_);
+        sock_ = -1;
+    }
+}
+
+bool UdpSocket::valid() const {
+    return sock_ >= 0;
+}
+
+bool UdpSocket::bind(int port) {
+    int yes = 1;
+    setsockopt(sock_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((unsigned short)port);
+    return ::bind(sock_, (const sockaddr*)&addr, sizeof(addr)) == 0;
+}
+
+int UdpSocket::localPort() const {
+    sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+    if (getsockname(sock_, (sockaddr*)&addr, &len) != 0) {
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
+bool UdpSocket::sendTo(const char* data, size_t len, const sockaddr_in& addr) {
+    return sendto(sock_, data, len, 0, (const sockaddr*)&addr, sizeof(addr)) >= 0;
+}
+
+bool UdpSocket::setReceiveBuffer(int bytes) {
+    return setsockopt(sock_, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes)) == 0;
+}
+
+bool UdpSocket::watch() {
+    return SetNonBlocking(sock_);
+}
+
+SocketWait UdpSocket::waitReadable(WakeEvent& wake, int timeout_ms) {
+    pollfd fds[2] = {
+        { sock_, POLLIN, 0 },
+        { wake.handle(), POLLIN, 0 },
+    };
+    int ready = poll(fds, 2, timeout_ms < 0 ? -1 : timeout_ms);
+    if (ready < 0) {
+        return errno == EINTR ? SOCKET_WOKEN : SOCKET_WAIT_FAILED;
+    }
+    if (ready == 0) {
+        return SOCKET_TIMEOUT;
+    }
+    if (fds[0].revents) {
+        return SOCKET_READABLE;
+    }
+    wake.wait(0);
+    return SOCKET_WOKEN;
+}
+
+SocketRecv UdpSocket::recv(char* buffer, size_t size, size_t& len, sockaddr_in* from) {
+    // recvmsg reports truncation portably; oversized datagrams are skipped like WSAEMSGSIZE
+    iovec iov = { buffer, size };
+    msghdr msg = {};
+    msg.msg_name = from;
+    msg.msg_namelen = from ? sizeof(*from) : 0;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    ssize_t bytes = recvmsg(sock_, &msg, 0);
+    if (bytes < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return RECV_WOULD_BLOCK;
+        }
+        if (errno == EINTR || errno == ECONNREFUSED) {
+            return RECV_SKIPPED;
+        }
+        return RECV_ERROR;
+    }
+    if (msg.msg_flags & MSG_TRUNC) {
+        return RECV_SKIPPED;
+    }
+    len = (size_t)bytes;
+    return RECV_OK;
+}
+
+int64_t MonotonicTicks() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int64_t MonotonicFrequency() {
+    return 1000000000;
+}
+
+bool MappedFile::open(const char* path, size_t size, bool create) {
+    close();
+    int fd = ::open(path, O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0644);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    bool sized = fstat(fd, &st) == 0 && (size_t)st.st_size == size;
+    if (!sized && create) {
+        sized = ftruncate(fd, (off_t)size) == 0;
+#ifdef __linux__
+        // Reserve the blocks now: touching a sparse page on a full disk would raise SIGBUS
+        if (sized) {
+            int error = posix_fallocate(fd, 0, (off_t)size);
+            sized = error == 0 || error == EOPNOTSUPP || error == EINVAL;
+        }
+#endif
+    }
+    void* data = sized ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd); // the mapping keeps the file open
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    data_ = (char*)data;
+    size_ = size;
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_) {
+        munmap(data_, size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
+bool MakeDirectory(const char* path) {
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+bool RemoveFile(const char* path) {
+    return unlink(path) == 0;
+}
+
+bool RemoveEmptyDirectory(const char* path) {
+    return rmdir(path) == 0;
+}
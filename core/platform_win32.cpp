@@ -0,0 +1,201 @@
+// platform_win32.cpp
+// Winsock backend used by the MetaHook plugin
+#include "platform.h"
+
+#pragma comment(lib, "ws2_32.lib")
+
+SocketRuntime::SocketRuntime() {
+    WSADATA wsaData;
+    int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
+    if (result == 0) {
+        if (LOBYTE(wsaData.wVersion) == 2 && HIBYTE(wsaData.wVersion) == 2) {
+            initialized_ = true;
+        }
+        else {
+            WSACleanup();
+        }
+    }
+}
+
+SocketRuntime::~SocketRuntime() {
+    if (initialized_) {
+        WSACleanup();
+    }
+}
+
+WakeEvent::WakeEvent() : handle_(CreateEventA(nullptr, FALSE, FALSE, nullptr)) {}
+
+WakeEvent::~WakeEvent() {
+    if (handle_) {
+        CloseHandle(handle_);
+    }
+}
+
+void WakeEvent::set() {
+    SetEvent(handle_);
+}
+
+bool WakeEvent::wait(int timeout_ms) {
+    return WaitForSingleObject(handle_, timeout_ms < 0 ? INFINITE : (DWORD)timeout_ms) == WAIT_OBJECT_0;
+}
+
+NativeWaitHandle WakeEvent::handle() const {
+    return handle_;
+}
+
+bool UdpSocket::open() {
+    close();
+    sock_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    return sock_ != INVALID_SOCKET;
+}
+
+void UdpSocket::close() {
+    if (sock_ != INVALID_SOCKET) {
+        closesocket(sock_);
+        sock_ = INVALID_SOCKET;
+    }
+    if (event_ != WSA_INVALID_EVENT) {
+        WSACloseEvent(event_);
+        event_ = WSA_INVALID_EVENT;
+    }
+}
+
+bool UdpSocket::valid() const {
+    return sock_ != INVALID_SOCKET;
+}
+
+bool UdpSocket::bind(int port) {
+    BOOL yes = TRUE;
+    setsockopt(sock_, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&yes), sizeof(yes));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons((unsigned short)port);
+    return ::bind(sock_, (const sockaddr*)&addr, sizeof(addr)) != SOCKET_ERROR;
+}
+
+int UdpSocket::localPort() const {
+    sockaddr_in addr = {};
+    int len = sizeof(addr);
+    if (getsockname(sock_, (sockaddr*)&addr, &len) == SOCKET_ERROR) {
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
+bool UdpSocket::sendTo(const char* data, size_t len, const sockaddr_in& addr) {
+    return sendto(sock_, data, (int)len, 0, (const sockaddr*)&addr, sizeof(addr)) != SOCKET_ERROR;
+}
+
+bool UdpSocket::setReceiveBuffer(int bytes) {
+    return setsockopt(sock_, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&bytes), sizeof(bytes)) != SOCKET_ERROR;
+}
+
+// WSAEventSelect also makes the socket non-blocking
+bool UdpSocket::watch() {
+    if (event_ == WSA_INVALID_EVENT) {
+        event_ = WSACreateEvent();
+        if (event_ == WSA_INVALID_EVENT) {
+            return false;
+        }
+    }
+    return WSAEventSelect(sock_, event_, FD_READ) != SOCKET_ERROR;
+}
+
+SocketWait UdpSocket::waitReadable(WakeEvent& wake, int timeout_ms) {
+    const WSAEVENT events[2] = { event_, wake.handle() };
+    DWORD result = WSAWaitForMultipleEvents(2, events, FALSE,
+        timeout_ms < 0 ? WSA_INFINITE : (DWORD)timeout_ms, FALSE);
+    if (result == WSA_WAIT_FAILED) {
+        return SOCKET_WAIT_FAILED;
+    }
+    if (result == WSA_WAIT_TIMEOUT) {
+        return SOCKET_TIMEOUT;
+    }
+    if (result != WSA_WAIT_EVENT_0) {
+        return SOCKET_WOKEN;
+    }
+    WSAResetEvent(event_);
+    return SOCKET_READABLE;
+}
+
+SocketRecv UdpSocket::recv(char* buffer, size_t size, size_t& len, sockaddr_in* from) {
+    int fromLen = sizeof(sockaddr_in);
+    int bytes = recvfrom(sock_, buffer, (int)size, 0, reinterpret_cast<sockaddr*>(from), from ? &fromLen : NULL);
+    if (bytes == SOCKET_ERROR) {
+        int error = WSAGetLastError();
+        if (error == WSAEWOULDBLOCK) {
+            return RECV_WOULD_BLOCK;
+        }
+        if (error == WSAEMSGSIZE || error == WSAECONNRESET) {
+            return RECV_SKIPPED;
+        }
+        return RECV_ERROR;
+    }
+    len = (size_t)bytes;
+    return RECV_OK;
+}
+
+int64_t MonotonicTicks() {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+int64_t MonotonicFrequency() {
+    static const int64_t frequency = []() {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        return f.QuadPart > 0 ? f.QuadPart : 1;
+    }();
+    return frequency;
+}
+
+bool MappedFile::open(const char* path, size_t size, bool create) {
+    close();
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+        create ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER current;
+    bool sized = GetFileSizeEx(file, &current) && current.QuadPart == (LONGLONG)size;
+    if (!sized && create) {
+        LARGE_INTEGER target;
+        target.QuadPart = (LONGLONG)size;
+        sized = SetFilePointerEx(file, target, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+    }
+    HANDLE mapping = sized ? CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+        (DWORD)((uint64_t)size >> 32), (DWORD)size, nullptr) : nullptr;
+    CloseHandle(file); // the view keeps the file and the mapping alive
+    void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size) : nullptr;
+    if (mapping) {
+        CloseHandle(mapping);
+    }
+    if (!data) {
+        return false;
+    }
+    data_ = (char*)data;
+    size_ = size;
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_) {
+        UnmapViewOfFile(data_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
+bool MakeDirectory(const char* path) {
+    return CreateDirectoryA(path, nullptr) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+bool RemoveFile(const char* path) {
+    return DeleteFileA(path) != 0;
+}
+
+bool RemoveEmptyDirectory(const char* path) {
+    return RemoveDirectoryA(path) != 0;
+}
@@ -0,0 +1,213 @@
+// spool.cpp
+#include "forwarder.h"
+
+// Segment header: [magic][uint64 serial][uint32 read offset][uint32 write offset], zero padded.
+// The serial orders segments across slots; offsets are from the start of the file.
+static const char kSpoolMagic[8] = { 'C', 'F', 'S', 'P', 'O', 'O', 'L', '1' };
+
+static uint64_t SegmentSerial(const char* base) {
+    uint64_t value;
+    memcpy(&value, base + 8, sizeof(value));
+    return value;
+}
+
+static uint32_t SegmentOffset(const char* base, size_t field) {
+    uint32_t value;
+    memcpy(&value, base + field, sizeof(value));
+    return value;
+}
+
+static void SetSegmentOffset(char* base, size_t field, uint32_t value) {
+    memcpy(base + field, &value, sizeof(value));
+}
+
+static const size_t READ_OFFSET = 16;
+static const size_t WRITE_OFFSET = 20;
+
+// Records in [from, to) of a segment; stops at the first one that does not parse
+static uint64_t CountRecords(const char* base, uint32_t from, uint32_t to) {
+    uint64_t count = 0;
+    while (from + 4 < to) {
+        uint32_t len = SegmentOffset(base, from);
+        if (len == 0 || len > to - from - 4) {
+            break;
+        }
+        from += 4 + len;
+        count++;
+    }
+    return count;
+}
+
+std::string Spool::pathOf(int slot) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/spool_%04d.seg", slot);
+    return directory_ + name;
+}
+
+bool Spool::configure(const char* directory, size_t capBytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t slots = capBytes / SPOOL_SEGMENT_BYTES;
+    if (directory_ == directory && slotUsed_.size() == slots) {
+        return !directory_.empty();
+    }
+    closeLocked();
+    if (!directory[0] || slots == 0 || !MakeDirectory(directory)) {
+        return false;
+    }
+    directory_ = directory;
+    slotUsed_.assign(slots, false);
+
+    // Pick up what an earlier session left; fully replayed or foreign files are reused later
+    uint64_t pending = 0;
+    for (int slot = 0; slot < (int)slots; slot++) {
+        std::unique_ptr<Segment> segment(new Segment);
+        segment->slot = slot;
+        if (!segment->file.open(pathOf(slot).c_str(), SPOOL_SEGMENT_BYTES, false)) {
+            continue;
+        }
+        const char* base = segment->file.data();
+        uint32_t read = SegmentOffset(base, READ_OFFSET), write = SegmentOffset(base, WRITE_OFFSET);
+        if (memcmp(base, kSpoolMagic, sizeof(kSpoolMagic)) != 0 || read < SPOOL_HEADER_SIZE ||
+            read > write || write > SPOOL_SEGMENT_BYTES || read == write) {
+            continue;
+        }
+        pending += write - read;
+        slotUsed_[slot] = true;
+        segments_.push_back(std::move(segment));
+    }
+    std::sort(segments_.begin(), segments_.end(),
+        [](const std::unique_ptr<Segment>& a, const std::unique_ptr<Segment>& b) {
+            return SegmentSerial(a->file.data()) < SegmentSerial(b->file.data());
+        });
+    nextSerial_ = segments_.empty() ? 1 : SegmentSerial(segments_.back()->file.data()) + 1;
+    pending_.store(pending, std::memory_order_relaxed);
+    return true;
+}
+
+void Spool::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closeLocked();
+}
+
+void Spool::closeLocked() {
+    segments_.clear();
+    slotUsed_.clear();
+    directory_.clear();
+    peeked_ = false;
+    pending_.store(0, std::memory_order_relaxed);
+}
+
+// Starts a new write segment in a free slot, or over the oldest segment when none is free
+bool Spool::rotate() {
+    std::unique_ptr<Segment> segment;
+    auto freeSlot = std::find(slotUsed_.begin(), slotUsed_.end(), false);
+    if (freeSlot != slotUsed_.end()) {
+        segment.reset(new Segment);
+        segment->slot = (int)(freeSlot - slotUsed_.begin());
+        if (!segment->file.open(pathOf(segment->slot).c_str(), SPOOL_SEGMENT_BYTES, true)) {
+            return false;
+        }
+        slotUsed_[segment->slot] = true;
+    }
+    else {
+        segment = std::move(segments_.front());
+        segments_.pop_front();
+        const char* base = segment->file.data();
+        uint32_t read = SegmentOffset(base, READ_OFFSET), write = SegmentOffset(base, WRITE_OFFSET);
+        lost_.fetch_add(CountRecords(base, read, write), std::memory_order_relaxed);
+        pending_.fetch_sub(write - read, std::memory_order_relaxed);
+        peeked_ = false;
+    }
+
+    char* base = segment->file.data();
+    memset(base, 0, SPOOL_HEADER_SIZE);
+    uint64_t serial = nextSerial_++;
+    memcpy(base + 8, &serial, sizeof(serial));
+    SetSegmentOffset(base, READ_OFFSET, (uint32_t)SPOOL_HEADER_SIZE);
+    SetSegmentOffset(base, WRITE_OFFSET, (uint32_t)SPOOL_HEADER_SIZE);
+    memcpy(base, kSpoolMagic, sizeof(kSpoolMagic)); // last: a torn header never looks valid
+    segments_.push_back(std::move(segment));
+    return true;
+}
+
+// Drops the fully replayed head segment; its file goes too, so a restart will not rescan it
+void Spool::retireHead() {
+    std::unique_ptr<Segment> head = std::move(segments_.front());
+    segments_.pop_front();
+    slotUsed_[head->slot] = false;
+    head->file.close();
+    RemoveFile(pathOf(head->slot).c_str());
+}
+
+bool Spool::append(char tag, const char* data, size_t len) {
+    uint32_t recordLen = (uint32_t)(1 + len);
+    if (len >= MAX_RECORD_SIZE) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (slotUsed_.empty()) {
+        return false;
+    }
+    if (segments_.empty() ||
+        SegmentOffset(segments_.back()->file.data(), WRITE_OFFSET) + 4 + recordLen > SPOOL_SEGMENT_BYTES) {
+        if (!rotate()) {
+            return false;
+        }
+    }
+    char* base = segments_.back()->file.data();
+    uint32_t write = SegmentOffset(base, WRITE_OFFSET);
+    memcpy(base + write, &recordLen, 4);
+    base[write + 4] = tag;
+    memcpy(base + write + 5, data, len);
+    SetSegmentOffset(base, WRITE_OFFSET, write + 4 + recordLen);
+    pending_.fetch_add(4 + recordLen, std::memory_order_relaxed);
+    return true;
+}
+
+bool Spool::peek(char* out, size_t outSize, size_t& outLen) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (!segments_.empty()) {
+        char* base = segments_.front()->file.data();
+        uint32_t read = SegmentOffset(base, READ_OFFSET), write = SegmentOffset(base, WRITE_OFFSET);
+        if (read < write) {
+            uint32_t recordLen = SegmentOffset(base, read);
+            if (recordLen == 0 || recordLen > write - read - 4 || recordLen > outSize) {
+                // Damaged on disk: give up on the rest of this segment
+                lost_.fetch_add(1, std::memory_order_relaxed);
+                pending_.fetch_sub(write - read, std::memory_order_relaxed);
+                SetSegmentOffset(base, READ_OFFSET, write);
+                continue;
+            }
+            memcpy(out, base + read + 4, recordLen);
+            outLen = recordLen;
+            peeked_ = true;
+            peekSerial_ = SegmentSerial(base);
+            peekOffset_ = read;
+            return true;
+        }
+        if (segments_.size() == 1) {
+            // Caught up with the write segment: rewind it instead of starting a new file
+            SetSegmentOffset(base, READ_OFFSET, (uint32_t)SPOOL_HEADER_SIZE);
+            SetSegmentOffset(base, WRITE_OFFSET, (uint32_t)SPOOL_HEADER_SIZE);
+            return false;
+        }
+        retireHead();
+    }
+    return false;
+}
+
+void Spool::consume() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!peeked_ || segments_.empty()) {
+        return;
+    }
+    peeked_ = false;
+    char* base = segments_.front()->file.data();
+    // An append may have rotated over the peeked segment in the meantime
+    if (SegmentSerial(base) != peekSerial_ || SegmentOffset(base, READ_OFFSET) != peekOffset_) {
+        return;
+    }
+    uint32_t recordLen = SegmentOffset(base, peekOffset_);
+    SetSegmentOffset(base, READ_OFFSET, peekOffset_ + 4 + recordLen);
+    pending_.fetch_sub(4 + recordLen, std::memory_order_relaxed);
+}
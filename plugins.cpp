@@ -1,248 +1,107 @@
 // plugins.cpp
 #include "plugins.h"
 #include "Interface/IPlugins.h"
-#include <chrono>
-#pragma comment(lib, "ws2_32.lib")
+#include <cstdarg>
 cl_enginefunc_t gEngfuncs;
 cl_exportfuncs_t gExportfuncs;
 metahook_api_t* g_pMetaHookAPI = NULL;
 mh_interface_t* g_pInterface = NULL;
 mh_enginesave_t* g_pMetaSave = NULL;
 
-MessageQueue g_messageQueue;
-cvar_t* cf_server_ip = NULL;
-cvar_t* cf_server_port = NULL;
-cvar_t* cf_listen_port = NULL;
-cvar_t* cf_enabled = NULL;
-cvar_t* cf_debug = NULL;
-cvar_t* cf_listen_only = NULL;
-cvar_t* cf_command_delay = NULL;
+cvar_t* g_cvars[CVAR_COUNT] = {};
 
-std::chrono::steady_clock::time_point g_lastCommandTime;
 void (*g_pfnHUD_Init)(void) = NULL;
 void (*g_pfnHUD_Frame)(double time) = NULL;
 ThreadPoolHandle_t g_hThreadPool = nullptr;
-ThreadWorkItemHandle_t g_hListenerWorkItem = nullptr;
-std::atomic<bool> g_shutdownListener(false);
-std::unique_ptr<WinsockRAII> g_winsock = nullptr;
-SendQueue g_sendQueue;
-ThreadWorkItemHandle_t g_hSenderWorkItem = nullptr;
-std::atomic<bool> g_shutdownSender(false);
+ThreadWorkItemHandle_t g_hReactorWorkItem = nullptr;
+std::unique_ptr<SocketRuntime> g_socketRuntime = nullptr;
 pfnUserMsgHook g_pfnTextMsg = NULL;
 
 void (WINAPI* g_pfnOutputDebugStringA)(LPCSTR lpOutputString) = NULL;
-
-void WINAPI NewOutputDebugStringA(LPCSTR lpOutputString) {
-    static thread_local bool g_inHook = false;
-    if (g_inHook || !lpOutputString || !lpOutputString[0]) {
-        if (g_pfnOutputDebugStringA) g_pfnOutputDebugStringA(lpOutputString);
-        return;
-    }
-
-    g_inHook = true;
-
-    if (IsCvarValid(cf_enabled) && atoi(cf_enabled->string) != 0) {
-        static std::string g_sysLogBuffer;
-        static std::mutex g_logMutex;
-
-        std::lock_guard<std::mutex> lock(g_logMutex);
-        g_sysLogBuffer += lpOutputString;
-
-        size_t pos;
-        while ((pos = g_sysLogBuffer.find('\n')) != std::string::npos) {
-            std::string line = g_sysLogBuffer.substr(0, pos);
-            // Remove \r if present at the end
-            if (!line.empty() && line.back() == '\r') {
-                line.pop_back();
-            }
-            
-            g_sysLogBuffer.erase(0, pos + 1);
-
-            std::string cleanMsg = CleanMessage(line.c_str());
-            if (!cleanMsg.empty()) {
-                std::string fullMsg;
-                fullMsg += MSG_TYPE_SYS;
-                fullMsg += cleanMsg;
-
-                SendTask task;
-                strncpy_s(task.message, fullMsg.c_str(), sizeof(task.message) - 1);
-                strncpy_s(task.server_ip, cf_server_ip->string, sizeof(task.server_ip) - 1);
-                task.port = atoi(cf_server_port->string);
-                g_sendQueue.push(task);
-            }
-        }
-
-        // Safety valve: if buffer grows too large without newline, flush it
-        if (g_sysLogBuffer.size() > 4096) {
-             std::string cleanMsg = CleanMessage(g_sysLogBuffer.c_str());
-             if (!cleanMsg.empty()) {
-                std::string fullMsg;
-                fullMsg += MSG_TYPE_SYS;
-                fullMsg += cleanMsg;
-
-                SendTask task;
-                strncpy_s(task.message, fullMsg.c_str(), sizeof(task.message) - 1);
-                strncpy_s(task.server_ip, cf_server_ip->string, sizeof(task.server_ip) - 1);
-                task.port = atoi(cf_server_port->string);
-                g_sendQueue.push(task);
-             }
-             g_sysLogBuffer.clear();
-        }
-    }
-
-    if (g_pfnOutputDebugStringA) g_pfnOutputDebugStringA(lpOutputString);
-    g_inHook = false;
+void (*g_pfnCon_Printf)(char* fmt, ...) = NULL;
+
+// Engine shim for the core. The HLSDK prototypes take non-const char*, so each call
+// goes through a small wrapper instead of casting the engine pointers.
+static void EngineConPrintf(const char* fmt, ...) {
+    char text[1024];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    // Past the Con_Printf hook: our own lines are not command output
+    (g_pfnCon_Printf ? g_pfnCon_Printf : gEngfuncs.Con_Printf)(const_cast<char*>("%s"), text);
 }
 
-bool UDPListenerWorkCallback(void* ctx)
-{
-    SOCKET listenSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (listenSocket == INVALID_SOCKET) {
-        return true;
-    }
-    struct SocketGuard {
-        SOCKET sock;
-        SocketGuard(SOCKET s) : sock(s) {}
-        ~SocketGuard() {
-            if (sock != INVALID_SOCKET) {
-                closesocket(sock);
-            }
-        }
-    } socketGuard(listenSocket);
-    sockaddr_in serverAddr = {};
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_addr.s_addr = INADDR_ANY;
-    int listenPort = DEFAULT_LISTEN_PORT;
-    if (IsCvarValid(cf_listen_port)) {
-        int port = atoi(cf_listen_port->string);
-        if (port > 0 && port <= 65535) {
-            listenPort = port;
-        }
-    }
-    serverAddr.sin_port = htons(listenPort);
-    {
-        BOOL yes = TRUE;
-        setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR,
-                   reinterpret_cast<const char*>(&yes), sizeof(yes));
-    }
-    if (bind(listenSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
-        return true;
-    }
-    int timeout_ms = SOCKET_TIMEOUT_MS;
-    setsockopt(listenSocket, SOL_SOCKET, SO_RCVTIMEO,
-               reinterpret_cast<const char*>(&timeout_ms), sizeof(timeout_ms));
-    char buffer[256];
-    while (!g_shutdownListener.load(std::memory_order_relaxed))
-    {
-        if (IsCvarValid(cf_enabled) && atoi(cf_enabled->string) == 0) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            continue;
-        }
-        int bytesRead = recvfrom(listenSocket, buffer, sizeof(buffer), 0, NULL, NULL);
-        if (bytesRead > 0)
-        {
-            std::string msg(buffer, bytesRead);
+static void EngineClientCmd(const char* command) {
+    gEngfuncs.pfnClientCmd(const_cast<char*>(command));
+}
 
-            // Trim all trailing control characters and spaces
-            while (!msg.empty() && (unsigned char)msg.back() <= 32) {
-                msg.pop_back();
-            }
-            // Trim leading spaces
-            size_t first = msg.find_first_not_of(" \t\n\r");
-            if (first != std::string::npos && first > 0) {
-                msg = msg.substr(first);
-            }
+static const char* EngineCvarString(CvarId id) {
+    const cvar_t* cvar = g_cvars[id];
+    return cvar ? cvar->string : NULL;
+}
 
-            if (!msg.empty()) {
-                g_messageQueue.push(std::move(msg));
-            }
-        }
-        else if (bytesRead == SOCKET_ERROR) {
-            int error = WSAGetLastError();
-            if (error != WSAETIMEDOUT && error != WSAEWOULDBLOCK) {
-                break;
-            }
-        }
-    }
-    return true;
+static void EngineCvarSet(CvarId id, const char* value) {
+    gEngfuncs.Cvar_Set(const_cast<char*>(g_cvarSpecs[id].name), const_cast<char*>(value));
 }
 
-bool SenderWorkCallback(void* ctx) {
-    SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (sock == INVALID_SOCKET) {
-        return true;
-    }
+static int EngineCmdArgc(void) {
+    return gEngfuncs.Cmd_Argc();
+}
 
-    struct SocketGuard {
-        SOCKET sock;
-        SocketGuard(SOCKET s) : sock(s) {}
-        ~SocketGuard() {
-            if (sock != INVALID_SOCKET) {
-                closesocket(sock);
-            }
-        }
-    } socketGuard(sock);
+static const char* EngineCmdArgv(int index) {
+    return gEngfuncs.Cmd_Argv(index);
+}
 
-    while (!g_shutdownSender.load(std::memory_order_relaxed)) {
-        // Pause if plugin is disabled OR if listen-only mode is active
-        if (!IsCvarValid(cf_enabled) || atoi(cf_enabled->string) == 0 ||
-            (IsCvarValid(cf_listen_only) && atoi(cf_listen_only->string) != 0)) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            continue;
-        }
+EngineInterface g_engine = {
+    EngineConPrintf,
+    EngineClientCmd,
+    EngineCvarString,
+    EngineCvarSet,
+    EngineCmdArgc,
+    EngineCmdArgv,
+};
 
-        SendTask task;
-        // Batch processing: Drain the queue as fast as possible
-        // Wait 1ms for the first item, then process remaining items instantly
-        if (g_sendQueue.pop(task, 1)) {
-            do {
-                sockaddr_in addr = {};
-                addr.sin_family = AF_INET;
-                addr.sin_port = htons(task.port);
-                // If the IP is invalid (e.g. cvar not yet set), skip this task
-                if (inet_pton(AF_INET, task.server_ip, &addr.sin_addr) != 1) {
-                    continue;
-                }
-                sendto(sock, task.message, strlen(task.message), 0,
-                    (const sockaddr*)&addr, sizeof(addr));
-            } while (g_sendQueue.pop(task, 0)); // Pop instantly until empty
-        }
+void WINAPI NewOutputDebugStringA(LPCSTR lpOutputString) {
+    // Anything we print while forwarding must not feed back into the hook
+    static thread_local bool g_inHook = false;
+    if (!g_inHook) {
+        g_inHook = true;
+        Forwarder_DebugString(lpOutputString);
+        g_inHook = false;
     }
+    if (g_pfnOutputDebugStringA) g_pfnOutputDebugStringA(lpOutputString);
+}
 
-    return true;
+// Everything the engine prints to the console, svc_print included
+void NewCon_Printf(char* fmt, ...) {
+    char text[4096];    // the engine's own Con_Printf limit: nothing it would print is cut
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    if (g_commandScheduler.capturing()) {
+        Forwarder_ConPrint(text);
+    }
+    g_pfnCon_Printf(const_cast<char*>("%s"), text);
 }
 
 void CleanupResources()
 {
-    // 1. Signal all worker threads to stop
-    g_shutdownListener.store(true, std::memory_order_release);
-    g_shutdownSender.store(true, std::memory_order_release);
-
-    // 2. Wake up threads blocked on condition_variable so they exit immediately
-    //    instead of waiting for the next pop/push timeout
-    g_sendQueue.shutdown();
-    g_messageQueue.shutdown();
+    // 1. Signal the reactor to stop and wake it from its blocking wait
+    Forwarder_Shutdown();
 
-    // 3. Wait for listener thread to finish, then release its MetaHook work item
-    if (g_hListenerWorkItem) {
+    // 2. Wait for the reactor to finish, then release its MetaHook work item
+    if (g_hReactorWorkItem) {
         if (g_pMetaHookAPI && g_hThreadPool) {
-            g_pMetaHookAPI->WaitForWorkItemToComplete(g_hListenerWorkItem);
-            g_pMetaHookAPI->DeleteWorkItem(g_hListenerWorkItem);
+            g_pMetaHookAPI->WaitForWorkItemToComplete(g_hReactorWorkItem);
+            g_pMetaHookAPI->DeleteWorkItem(g_hReactorWorkItem);
         }
-        g_hListenerWorkItem = nullptr;
+        g_hReactorWorkItem = nullptr;
     }
 
-    // 4. Wait for sender thread to finish, then release its MetaHook work item
-    if (g_hSenderWorkItem) {
-        if (g_pMetaHookAPI && g_hThreadPool) {
-            g_pMetaHookAPI->WaitForWorkItemToComplete(g_hSenderWorkItem);
-            g_pMetaHookAPI->DeleteWorkItem(g_hSenderWorkItem);
-        }
-        g_hSenderWorkItem = nullptr;
-    }
-
-    // 5. Release Winsock
-    g_winsock.reset();
+    // 3. Release the socket runtime
+    g_socketRuntime.reset();
 }
 void ChatForwarder_Init(void)
 {
@@ -266,8 +125,8 @@ void ChatForwarder_Init(void)
             gEngfuncs.Con_Printf("ChatForwarder: Debugger detected.\n");
         }
 
-        g_winsock = std::unique_ptr<WinsockRAII>(new WinsockRAII());
-        if (!g_winsock->IsInitialized()) {
+        g_socketRuntime = std::unique_ptr<SocketRuntime>(new SocketRuntime());
+        if (!g_socketRuntime->IsInitialized()) {
             if (g_pMetaHookAPI) {
                 g_pMetaHookAPI->SysError("Failed to initialize Winsock");
             }
@@ -275,18 +134,28 @@ void ChatForwarder_Init(void)
         }
 
         if (gEngfuncs.pfnRegisterVariable) {
-            cf_server_ip = gEngfuncs.pfnRegisterVariable("cf_server_ip", "127.0.0.1", FCVAR_ARCHIVE);
-            cf_server_port = gEngfuncs.pfnRegisterVariable("cf_server_port", "26000", FCVAR_ARCHIVE);
-            cf_listen_port = gEngfuncs.pfnRegisterVariable("cf_listen_port", "26001", FCVAR_ARCHIVE);
-            cf_enabled = gEngfuncs.pfnRegisterVariable("cf_enabled", "1", FCVAR_ARCHIVE);
-            cf_debug = gEngfuncs.pfnRegisterVariable("cf_debug", "0", FCVAR_ARCHIVE);
-            cf_listen_only = gEngfuncs.pfnRegisterVariable("cf_listen_only", "0", FCVAR_ARCHIVE);
-            cf_command_delay = gEngfuncs.pfnRegisterVariable("cf_command_delay", "0", FCVAR_ARCHIVE);
+            for (int i = 0; i < CVAR_COUNT; i++) {
+                g_cvars[i] = gEngfuncs.pfnRegisterVariable(const_cast<char*>(g_cvarSpecs[i].name),
+                    const_cast<char*>(g_cvarSpecs[i].defaultValue), FCVAR_ARCHIVE);
+            }
+        }
+        if (gEngfuncs.pfnAddCommand) {
+            for (int i = 0; i < g_commandCount; i++) {
+                gEngfuncs.pfnAddCommand(const_cast<char*>(g_commandSpecs[i].name), g_commandSpecs[i].handler);
+            }
+        }
+
+        // Allocates the outbound lanes and publishes the first config snapshot
+        if (!Forwarder_Init()) {
+            g_pMetaHookAPI->SysError("ChatForwarder: Failed to allocate send queue");
+            return;
         }
 
         // Hook OutputDebugStringA in engine to capture everything DebugView sees
         // Only hook once!
         g_pMetaHookAPI->IATHook(g_pMetaHookAPI->GetEngineModule(), "kernel32.dll", "OutputDebugStringA", NewOutputDebugStringA, (void**)&g_pfnOutputDebugStringA);
+        // Console output is what a command request replies with
+        g_pMetaHookAPI->InlineHook((void*)gEngfuncs.Con_Printf, (void*)NewCon_Printf, (void**)&g_pfnCon_Printf);
 
         bInitialized = true;
     }
@@ -300,35 +169,19 @@ void ChatForwarder_Init(void)
         return;
     }
 
-    // Start Sender thread only if NOT in listen-only mode.
-    // cf_listen_only=1 means: accept inbound commands, but send nothing outbound.
-    // Runtime blocking is also handled inside SenderWorkCallback.
-    if (!g_hSenderWorkItem && (!IsCvarValid(cf_listen_only) || atoi(cf_listen_only->string) == 0)) {
-        g_shutdownSender.store(false, std::memory_order_relaxed);
-        g_hSenderWorkItem = g_pMetaHookAPI->CreateWorkItem(g_hThreadPool, SenderWorkCallback, nullptr);
-
-        if (!g_hSenderWorkItem) {
-            if (g_pMetaHookAPI) {
-                g_pMetaHookAPI->SysError("Failed to create sender work item");
-            }
-            return;
-        }
-        g_pMetaHookAPI->QueueWorkItem(g_hThreadPool, g_hSenderWorkItem);
-    }
-
-    // Always start the Listener thread — it handles inbound console commands
-    // regardless of cf_listen_only mode.
-    if (!g_hListenerWorkItem) {
-        g_shutdownListener.store(false, std::memory_order_relaxed);
-        g_hListenerWorkItem = g_pMetaHookAPI->CreateWorkItem(g_hThreadPool, UDPListenerWorkCallback, nullptr);
+    // One work item holds a pool thread for the session: it sends, receives inbound
+    // commands and runs the timers. cf_listen_only is handled inside ReactorWorkCallback.
+    if (!g_hReactorWorkItem) {
+        g_shutdownReactor.store(false, std::memory_order_relaxed);
+        g_hReactorWorkItem = g_pMetaHookAPI->CreateWorkItem(g_hThreadPool, ReactorWorkCallback, nullptr);
 
-        if (!g_hListenerWorkItem) {
+        if (!g_hReactorWorkItem) {
             if (g_pMetaHookAPI) {
-                g_pMetaHookAPI->SysError("Failed to create listener work item");
+                g_pMetaHookAPI->SysError("Failed to create reactor work item");
             }
             return;
         }
-        g_pMetaHookAPI->QueueWorkItem(g_hThreadPool, g_hListenerWorkItem);
+        g_pMetaHookAPI->QueueWorkItem(g_hThreadPool, g_hReactorWorkItem);
     }
 }
 void IPluginsV4::Init(metahook_api_t* pAPI, mh_interface_t* pInterface, mh_enginesave_t* pSave)
@@ -362,4 +215,4 @@ const char* IPluginsV4::GetVersion(void)
 {
     return "1.4.3";
 }
-EXPOSE_SINGLE_INTERFACE(IPluginsV4, IPluginsV4, METAHOOK_PLUGIN_API_VERSION_V4);
\ No newline at end of file
+EXPOSE_SINGLE_INTERFACE(IPluginsV4, IPluginsV4, METAHOOK_PLUGIN_API_VERSION_V4);
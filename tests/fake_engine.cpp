@@ -0,0 +1,251 @@
+// fake_engine.cpp
+#include "fake_engine.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+
+FakeEngine* FakeEngine::active_ = nullptr;
+
+EngineInterface g_engine = {};
+
+FakeEngine::FakeEngine() {
+    for (int i = 0; i < CVAR_COUNT; i++) {
+        cvars_[i] = g_cvarSpecs[i].defaultValue;
+    }
+}
+
+FakeEngine::~FakeEngine() {
+    stop();
+}
+
+// Binds a throwaway socket to port 0 and returns the port the OS handed out
+static int PickFreePort() {
+    UdpSocket probe;
+    if (!probe.open() || !probe.bind(0)) {
+        return 0;
+    }
+    return probe.localPort();
+}
+
+bool FakeEngine::start() {
+    if (running_ || active_ || !runtime_.IsInitialized()) {
+        return false;
+    }
+    if (!receiver_.open() || !receiver_.bind(0) || !receiver_.watch() ||
+        !commandSocket_.open() || !commandSocket_.watch()) {
+        return false;
+    }
+    // Room for a burst the receiver has not drained yet; floods would otherwise be lost in the kernel
+    receiver_.setReceiveBuffer(4 * 1024 * 1024);
+    receiverPort_ = receiver_.localPort();
+    listenPort_ = PickFreePort();
+    if (!receiverPort_ || !listenPort_ || !ResolveAddress("127.0.0.1", listenPort_, listenAddr_)) {
+        return false;
+    }
+    cvars_[CVAR_SERVER_IP] = "127.0.0.1";
+    cvars_[CVAR_SERVER_PORT] = std::to_string(receiverPort_);
+    cvars_[CVAR_LISTEN_PORT] = std::to_string(listenPort_);
+
+    active_ = this;
+    g_engine.Con_Printf = ConPrintf;
+    g_engine.ClientCmd = ClientCmd;
+    g_engine.CvarString = CvarString;
+    g_engine.CvarSet = CvarSet;
+    g_engine.Cmd_Argc = CmdArgc;
+    g_engine.Cmd_Argv = CmdArgv;
+    if (!Forwarder_Init()) {
+        active_ = nullptr;
+        return false;
+    }
+
+    reactor_ = std::thread(ReactorWorkCallback, nullptr);
+    running_ = true;
+    return true;
+}
+
+void FakeEngine::stop() {
+    if (!running_) {
+        return;
+    }
+    Forwarder_Shutdown();
+    reactor_.join();
+    running_ = false;
+}
+
+void FakeEngine::setCvar(CvarId id, const char* value) {
+    cvars_[id] = value;
+}
+
+void FakeEngine::frame() {
+    Forwarder_Frame();
+}
+
+bool FakeEngine::command(const char* line) {
+    std::vector<std::string> args;
+    for (const char* p = line; *p; ) {
+        while (*p == ' ') p++;
+        const char* end = p;
+        while (*end && *end != ' ') end++;
+        if (end > p) args.emplace_back(p, end);
+        p = end;
+    }
+    if (args.empty()) {
+        return false;
+    }
+    for (int i = 0; i < g_commandCount; i++) {
+        if (args[0] == g_commandSpecs[i].name) {
+            args_ = args;
+            g_commandSpecs[i].handler();
+            args_.clear();
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<char> FakeEngine::UserMsg(int firstByte, const char* format, std::initializer_list<const char*> args) {
+    std::vector<char> msg(1, (char)firstByte);
+    auto appendString = [&msg](const char* str) {
+        size_t len = strlen(str) + 1;
+        msg.resize(msg.size() + len);
+        memcpy(&msg[msg.size() - len], str, len);
+    };
+    appendString(format);
+    for (const char* arg : args) {
+        appendString(arg);
+    }
+    return msg;
+}
+
+void FakeEngine::sayText(int client, const char* format, std::initializer_list<const char*> args) {
+    std::vector<char> msg = UserMsg(client, format, args);
+    Forwarder_SayText(msg.data(), (int)msg.size());
+}
+
+void FakeEngine::textMsg(int dest, const char* format, std::initializer_list<const char*> args) {
+    std::vector<char> msg = UserMsg(dest, format, args);
+    Forwarder_TextMsg(msg.data(), (int)msg.size());
+}
+
+bool FakeEngine::receive(std::string& datagram, int timeoutMs) {
+    return ReceiveDatagram(receiver_, receiveWake_, datagram, timeoutMs);
+}
+
+bool ReceiveDatagram(UdpSocket& socket, WakeEvent& wake, std::string& datagram, int timeoutMs) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    char buffer[MAX_FRAME_MTU];
+    for (;;) {
+        size_t len = 0;
+        SocketRecv status = socket.recv(buffer, sizeof(buffer), len);
+        if (status == RECV_OK) {
+            datagram.assign(buffer, len);
+            return true;
+        }
+        if (status == RECV_ERROR) {
+            return false;
+        }
+        if (status == RECV_SKIPPED) {
+            continue;
+        }
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0 || socket.waitReadable(wake, (int)remaining) == SOCKET_TIMEOUT) {
+            return false;
+        }
+    }
+}
+
+bool FragmentReassembler::add(const char* body, size_t len, std::string& event) {
+    if (len < FRAGMENT_HEADER_SIZE) {
+        return false;
+    }
+    const unsigned char* header = reinterpret_cast<const unsigned char*>(body);
+    uint16_t id = (uint16_t)(header[1] | (header[2] << 8));
+    size_t index = header[3], count = header[4];
+    if (index >= count) {
+        return false;
+    }
+
+    Pending& pending = pending_[id];
+    if (pending.pieces.size() != count || pending.tag != body[0]) {
+        // New id, or the 16-bit id wrapped onto a stale one
+        pending = Pending();
+        pending.tag = body[0];
+        pending.pieces.resize(count);
+        pending.seen.assign(count, false);
+    }
+    if (!pending.seen[index]) {
+        pending.seen[index] = true;
+        pending.pieces[index].assign(body + FRAGMENT_HEADER_SIZE, len - FRAGMENT_HEADER_SIZE);
+        pending.received++;
+    }
+    if (pending.received < count) {
+        return false;
+    }
+
+    event.assign(1, pending.tag);
+    for (const std::string& piece : pending.pieces) {
+        event += piece;
+    }
+    pending_.erase(id);
+    return true;
+}
+
+bool FakeEngine::sendCommand(const std::string& text) {
+    return commandSocket_.sendTo(text.data(), text.size(), listenAddr_);
+}
+
+bool FakeEngine::receiveReply(std::string& datagram, int timeoutMs) {
+    return ReceiveDatagram(commandSocket_, replyWake_, datagram, timeoutMs);
+}
+
+std::vector<std::string> FakeEngine::takeCommands() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> taken;
+    taken.swap(commands_);
+    return taken;
+}
+
+std::vector<std::string> FakeEngine::takeConsole() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> taken;
+    taken.swap(console_);
+    return taken;
+}
+
+void FakeEngine::ConPrintf(const char* fmt, ...) {
+    char text[2048];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    if (getenv("CF_VERBOSE")) {
+        fputs(text, stdout);
+    }
+    std::lock_guard<std::mutex> lock(active_->mutex_);
+    active_->console_.push_back(text);
+}
+
+void FakeEngine::ClientCmd(const char* command) {
+    std::lock_guard<std::mutex> lock(active_->mutex_);
+    active_->commands_.push_back(command);
+}
+
+// Game thread only, like the real cvar table; the core never reads cvars from its workers
+const char* FakeEngine::CvarString(CvarId id) {
+    return active_->cvars_[id].c_str();
+}
+
+void FakeEngine::CvarSet(CvarId id, const char* value) {
+    active_->cvars_[id] = value;
+}
+
+int FakeEngine::CmdArgc(void) {
+    return (int)active_->args_.size();
+}
+
+const char* FakeEngine::CmdArgv(int index) {
+    return index >= 0 && index < (int)active_->args_.size() ? active_->args_[index].c_str() : "";
+}
@@ -0,0 +1,114 @@
+// fake_engine.h
+// In-process stand-in for the GoldSrc client. It implements the engine shim, runs the
+// reactor work item on a plain thread instead of the MetaHook pool, and owns a loopback
+// UDP socket that plays the receiver. Hooks are driven with synthetic
+// user-message buffers laid out the way the engine hands them to HookUserMsg callbacks.
+// The core is a set of globals, so a process can start one FakeEngine, once.
+#ifndef CF_FAKE_ENGINE_H
+#define CF_FAKE_ENGINE_H
+
+#include "core/forwarder.h"
+
+#include <initializer_list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class FakeEngine {
+public:
+    FakeEngine();
+    ~FakeEngine();
+
+    // Installs the shim, points cf_server_port/cf_listen_port at loopback ports picked for
+    // this run, initializes the core and starts the reactor
+    bool start();
+    void stop();
+
+    void setCvar(CvarId id, const char* value);
+
+    // One client frame (HUD_Frame): publishes cvar changes and runs queued commands
+    void frame();
+
+    // Runs a registered console command, e.g. "cf_latency reset"
+    bool command(const char* line);
+
+    // [first byte][format\0][arg\0]..., the SayText (client index) / TextMsg (destination) layout
+    static std::vector<char> UserMsg(int firstByte, const char* format,
+        std::initializer_list<const char*> args = {});
+    void sayText(int client, const char* format, std::initializer_list<const char*> args = {});
+    void textMsg(int dest, const char* format, std::initializer_list<const char*> args = {});
+    // The engine's print handler ends in Con_Printf, past the hook
+    void print(const char* text) { Forwarder_NetPrint(text); Forwarder_ConPrint(text); }
+    void stuffText(const char* text) { Forwarder_StuffText(text); }
+    void debugString(const char* text) { Forwarder_DebugString(text); }
+    // Console output of a command the engine ran, e.g. cvarlist
+    void conPrint(const char* text) { Forwarder_ConPrint(text); }
+
+    // Next datagram the sender put on the wire; false after timeoutMs without one
+    bool receive(std::string& datagram, int timeoutMs = 1000);
+
+    // Sends one inbound command datagram to cf_listen_port
+    bool sendCommand(const std::string& text);
+    // Next command reply sent back to that socket; false after timeoutMs without one
+    bool receiveReply(std::string& datagram, int timeoutMs = 1000);
+
+    // Commands passed to ClientCmd / lines printed to the console since the last call
+    std::vector<std::string> takeCommands();
+    std::vector<std::string> takeConsole();
+
+    int receiverPort() const { return receiverPort_; }
+    int listenPort() const { return listenPort_; }
+
+private:
+    static void ConPrintf(const char* fmt, ...);
+    static void ClientCmd(const char* command);
+    static const char* CvarString(CvarId id);
+    static void CvarSet(CvarId id, const char* value);
+    static int CmdArgc(void);
+    static const char* CmdArgv(int index);
+
+    static FakeEngine* active_;
+
+    SocketRuntime runtime_;
+    UdpSocket receiver_;
+    UdpSocket commandSocket_;
+    WakeEvent receiveWake_;
+    WakeEvent replyWake_;
+    sockaddr_in listenAddr_ = {};
+    int receiverPort_ = 0;
+    int listenPort_ = 0;
+
+    std::string cvars_[CVAR_COUNT];
+    std::vector<std::string> args_;
+    std::mutex mutex_;
+    std::vector<std::string> commands_;
+    std::vector<std::string> console_;
+
+    std::thread reactor_;
+    bool running_ = false;
+};
+
+// Next datagram on a watch()ed socket; false after timeoutMs without one
+bool ReceiveDatagram(UdpSocket& socket, WakeEvent& wake, std::string& datagram, int timeoutMs = 1000);
+
+// Receiver side of MSG_TYPE_FRAGMENT, as a client would implement it: collects the pieces
+// of each fragment id and rebuilds the original [tag][body] once all of them arrived
+class FragmentReassembler {
+public:
+    // body is one fragment record without its MSG_TYPE_FRAGMENT tag
+    bool add(const char* body, size_t len, std::string& event);
+    size_t pending() const { return pending_.size(); }
+
+private:
+    struct Pending {
+        char tag = 0;
+        size_t received = 0;
+        std::vector<std::string> pieces;
+        std::vector<bool> seen;
+    };
+    std::map<uint16_t, Pending> pending_;
+};
+
+#endif // CF_FAKE_ENGINE_H
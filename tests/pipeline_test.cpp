@@ -0,0 +1,1172 @@
+// pipeline_test.cpp
+// Drives the core through the fake engine: hooks -> SendQueue -> sender -> loopback
+// receiver, and inbound datagram -> reactor -> HUD_Frame -> ClientCmd.
+#include "fake_engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <random>
+
+static int g_failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_failures++; \
+        } \
+    } while (0)
+
+static std::string Tagged(char tag, const std::string& body) {
+    return std::string(1, tag) + body;
+}
+
+// Next v1 event; fragmented events come back reassembled
+static std::string Next(FakeEngine& engine) {
+    static FragmentReassembler reassembler;
+    std::string datagram, event;
+    while (engine.receive(datagram)) {
+        if (datagram.empty() || datagram[0] != MSG_TYPE_FRAGMENT) {
+            return datagram;
+        }
+        if (reassembler.add(datagram.data() + 1, datagram.size() - 1, event)) {
+            return event;
+        }
+    }
+    return "<timeout>";
+}
+
+// Publishes cvar changes and gives the sender time to pick up the new snapshot
+static void Apply(FakeEngine& engine) {
+    engine.frame();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+}
+
+// Runs frames until the expected number of commands came through or a second passes
+static std::vector<std::string> RunCommands(FakeEngine& engine, size_t expected) {
+    std::vector<std::string> executed;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (executed.size() < expected && std::chrono::steady_clock::now() < deadline) {
+        engine.frame();
+        for (std::string& command : engine.takeCommands()) {
+            executed.push_back(std::move(command));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return executed;
+}
+
+static void TestCleanMessageKernels() {
+    std::mt19937 rng(1234);
+    std::vector<char> input(4096), expected(input.size() + 1), actual(input.size() + 1);
+    for (int round = 0; round < 200; round++) {
+        size_t len = rng() % input.size();
+        for (size_t i = 0; i < len; i++) {
+            // Mostly text with some control bytes, like real engine strings
+            input[i] = (char)(rng() % 8 == 0 ? rng() % 0x20 : 0x20 + rng() % 0xE0);
+        }
+        size_t n = CleanMessageScalar(input.data(), len, expected.data());
+        CHECK(CleanMessage(input.data(), len, actual.data()) == n);
+        CHECK(memcmp(expected.data(), actual.data(), n + 1) == 0);
+#if CF_HAVE_SSE2
+        CHECK(CleanMessageSSE2(input.data(), len, actual.data()) == n);
+        CHECK(memcmp(expected.data(), actual.data(), n + 1) == 0);
+#endif
+#if CF_HAVE_AVX2 && defined(__AVX2__)
+        CHECK(CleanMessageAVX2(input.data(), len, actual.data()) == n);
+        CHECK(memcmp(expected.data(), actual.data(), n + 1) == 0);
+#endif
+    }
+    const char sample[] = "a\x07" "b\x02" "c\r\n\x1f";
+    char cleaned[sizeof(sample)];
+    CHECK(CleanMessage(sample, sizeof(sample) - 1, cleaned) == 6 && strcmp(cleaned, "ab\x02" "c\r\n") == 0);
+}
+
+static void TestOutboundV1(FakeEngine& engine) {
+    engine.sayText(1, "%s: %s", { "\x02Player", "hello" });
+    CHECK(Next(engine) == Tagged(MSG_TYPE_CHAT, "\x02Player: hello"));
+
+    engine.textMsg(3, "%s has joined the game", { "Bob" });
+    CHECK(Next(engine) == Tagged(MSG_TYPE_GAME, "Bob has joined the game"));
+
+    // Arguments without a placeholder are appended after a space
+    engine.textMsg(2, "#Cstrike_Chat", { "arg" });
+    CHECK(Next(engine) == Tagged(MSG_TYPE_GAME, "#Cstrike_Chat arg"));
+
+    // Destination 0 is not forwarded; the next event must come through first
+    engine.textMsg(0, "ignored");
+    engine.print("Server says hi\n");
+    CHECK(Next(engine) == Tagged(MSG_TYPE_NET, "Server says hi\n"));
+
+    engine.stuffText("echo \x07stuffed\n");
+    CHECK(Next(engine) == Tagged(MSG_TYPE_STUFF, "echo stuffed\n"));
+
+    // SYS output is line buffered
+    engine.debugString("first ");
+    engine.debugString("line\r\nsecond line\n");
+    CHECK(Next(engine) == Tagged(MSG_TYPE_SYS, "first line"));
+    CHECK(Next(engine) == Tagged(MSG_TYPE_SYS, "second line"));
+
+    // Truncated user message: the unterminated string still ends inside the copy
+    std::vector<char> msg = FakeEngine::UserMsg(1, "cut off");
+    msg.pop_back();
+    Forwarder_SayText(msg.data(), (int)msg.size());
+    CHECK(Next(engine) == Tagged(MSG_TYPE_CHAT, "cut off"));
+
+    // Oversized messages are parsed up to MAX_USERMSG_SIZE (first byte: client index)
+    std::vector<char> big(MAX_USERMSG_SIZE + 16, 'x');
+    Forwarder_SayText(big.data(), (int)big.size());
+    CHECK(Next(engine) == Tagged(MSG_TYPE_CHAT, std::string(MAX_USERMSG_SIZE - 1, 'x')));
+}
+
+static void TestDebugLines(FakeEngine& engine) {
+    // Many lines in one chunk, blank lines skipped
+    engine.debugString("one\n\ntwo\r\nthree\npartial");
+    CHECK(Next(engine) == Tagged(MSG_TYPE_SYS, "one"));
+    CHECK(Next(engine) == Tagged(MSG_TYPE_SYS, "two"));
+    CHECK(Next(engine) == Tagged(MSG_TYPE_SYS, "three"));
+
+    // Partial lines are kept per thread: another thread's line does not pick them up
+    std::thread other([&engine] { engine.debugString("other thread\n"); });
+    other.join();
+    CHECK(Next(engine) == Tagged(MSG_TYPE_SYS, "other thread"));
+    engine.debugString(" line\n");
+    CHECK(Next(engine) == Tagged(MSG_TYPE_SYS, "partial line"));
+
+    // An unterminated run is flushed once at SYS_LINE_FLUSH and its remainder dropped
+    engine.debugString(std::string(SYS_LINE_FLUSH + 100, 'y').c_str());
+    engine.debugString("rest of the run\nnext\n");
+    std::string flushed = Next(engine);
+    CHECK(flushed.size() > 1 && flushed.size() <= MAX_RECORD_SIZE);
+    CHECK(flushed.find_first_not_of('y', 1) == std::string::npos);
+    CHECK(Next(engine) == Tagged(MSG_TYPE_SYS, "next"));
+}
+
+// Random text over the bytes CleanMessage and the expander care about; never NUL
+static std::string RandomText(std::mt19937& rng, size_t maxLen) {
+    static const char alphabet[] = "abcXYZ 09%s~\x01\x02\x03\x04\x07\t\r\n\x1f\x7f\x80\xc3\xa9\xff";
+    std::string text(std::uniform_int_distribution<size_t>(0, maxLen)(rng), 'a');
+    for (char& c : text) {
+        c = alphabet[std::uniform_int_distribution<size_t>(0, sizeof(alphabet) - 2)(rng)];
+    }
+    return text;
+}
+
+// One pass of a seeded hook script; returns what arrived, per tag (lanes interleave by timing)
+static std::map<char, std::vector<std::string>> RunHookScript(FakeEngine& engine, uint32_t seed) {
+    std::mt19937 rng(seed);
+    auto pick = [&](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+    for (int i = 0; i < 300; i++) {
+        switch (pick(0, 5)) {
+        case 0:
+        case 1: {
+            std::string format = RandomText(rng, 40), arg1 = RandomText(rng, 60), arg2 = RandomText(rng, 20);
+            std::vector<char> msg = FakeEngine::UserMsg(pick(0, 5), format.c_str(), { arg1.c_str(), arg2.c_str() });
+            if (pick(0, 3) == 0) {
+                msg.resize(pick(0, (int)msg.size())); // truncated message
+            }
+            (pick(0, 1) ? Forwarder_SayText : Forwarder_TextMsg)(msg.data(), (int)msg.size());
+            break;
+        }
+        case 2: {
+            // Raw bytes, embedded NULs and oversized buffers included
+            std::vector<char> msg(pick(0, (int)MAX_USERMSG_SIZE + 8));
+            for (char& c : msg) c = (char)pick(0, 255);
+            Forwarder_TextMsg(msg.data(), (int)msg.size());
+            break;
+        }
+        case 3: engine.print(RandomText(rng, pick(0, 9) ? 80 : MAX_MESSAGE_STRING + 100).c_str()); break;
+        case 4: engine.stuffText(RandomText(rng, pick(0, 9) ? 80 : 1500).c_str()); break;
+        default: engine.debugString(RandomText(rng, 200).c_str()); break;
+        }
+        if (i % 25 == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+    engine.debugString("\n"); // no partial line carried into the next pass
+
+    std::map<char, std::vector<std::string>> received;
+    FragmentReassembler reassembler;
+    std::string datagram, event;
+    while (engine.receive(datagram, 300)) {
+        if (datagram[0] != MSG_TYPE_FRAGMENT) {
+            received[datagram[0]].push_back(datagram);
+        }
+        else if (reassembler.add(datagram.data() + 1, datagram.size() - 1, event)) {
+            received[event[0]].push_back(event);
+        }
+    }
+    return received;
+}
+
+// cf_deferred must put exactly the same bytes on the wire as the synchronous hooks
+static void TestDeferredMatchesSync(FakeEngine& engine) {
+    for (uint32_t seed = 1; seed <= 3; seed++) {
+        std::map<char, std::vector<std::string>> sync = RunHookScript(engine, seed);
+        engine.setCvar(CVAR_DEFERRED, "1");
+        Apply(engine);
+        uint64_t captured = ForwarderStats::Get(g_stats.captured);
+        std::map<char, std::vector<std::string>> deferred = RunHookScript(engine, seed);
+        CHECK(ForwarderStats::Get(g_stats.captured) > captured);
+        engine.setCvar(CVAR_DEFERRED, "0");
+        Apply(engine);
+
+        CHECK(sync.size() == LANE_COUNT);
+        CHECK(sync == deferred);
+    }
+}
+
+static void TestFramedV2(FakeEngine& engine) {
+    engine.setCvar(CVAR_PROTOCOL, "2");
+    engine.setCvar(CVAR_FLUSH_US, "200000");
+    Apply(engine);
+
+    const char* bodies[] = { "one", "two", "three" };
+    for (const char* body : bodies) {
+        engine.sayText(1, body);
+    }
+
+    std::string frame = Next(engine);
+    CHECK(frame.size() > PROTOCOL_V2_HEADER_SIZE);
+    CHECK((unsigned char)frame[0] == PROTOCOL_V2_MAGIC);
+    CHECK((unsigned char)frame[1] == PROTOCOL_V2_VERSION);
+    size_t pos = PROTOCOL_V2_HEADER_SIZE;
+    for (const char* body : bodies) {
+        CHECK(pos + 2 <= frame.size());
+        if (pos + 2 > frame.size()) break;
+        CHECK(frame[pos] == MSG_TYPE_CHAT);
+        size_t len = (unsigned char)frame[pos + 1];  // bodies < 128 bytes: one varint byte
+        CHECK(frame.compare(pos + 2, len, body) == 0);
+        pos += 2 + len;
+    }
+    CHECK(pos == frame.size());
+
+    engine.setCvar(CVAR_PROTOCOL, "1");
+    Apply(engine);
+}
+
+// Splits a v2 frame into its [tag][body] records
+static std::vector<std::string> FrameRecords(const std::string& frame) {
+    std::vector<std::string> records;
+    size_t pos = PROTOCOL_V2_HEADER_SIZE;
+    while (pos < frame.size()) {
+        char tag = frame[pos++];
+        size_t len = 0;
+        for (int shift = 0; pos < frame.size(); shift += 7) {
+            unsigned char byte = (unsigned char)frame[pos++];
+            len |= (size_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        len = (std::min)(len, frame.size() - pos);
+        records.push_back(std::string(1, tag) + frame.substr(pos, len));
+        pos += len;
+    }
+    return records;
+}
+
+static void TestFragments(FakeEngine& engine) {
+    std::string text;
+    for (int i = 0; text.size() < 5000; i++) {
+        text += "line " + std::to_string(i) + " of a long status dump\n";
+    }
+
+    // v1: one datagram per fragment, none larger than cf_frame_mtu
+    engine.print(text.c_str());
+    FragmentReassembler reassembler;
+    std::string datagram, event;
+    int pieces = 0;
+    while (engine.receive(datagram) && datagram[0] == MSG_TYPE_FRAGMENT) {
+        CHECK(datagram.size() <= DEFAULT_FRAME_MTU);
+        pieces++;
+        if (reassembler.add(datagram.data() + 1, datagram.size() - 1, event)) {
+            break;
+        }
+    }
+    CHECK(pieces == (int)((text.size() + DEFAULT_FRAME_MTU - 7) / (DEFAULT_FRAME_MTU - 6)));
+    CHECK(event == Tagged(MSG_TYPE_NET, text));
+
+    // v2: fragments are records sharing frames with regular events
+    engine.setCvar(CVAR_PROTOCOL, "2");
+    engine.setCvar(CVAR_FRAME_MTU, "1100");
+    engine.setCvar(CVAR_FLUSH_US, "200000");
+    Apply(engine);
+    engine.sayText(1, "before");
+    engine.stuffText(text.c_str());
+    engine.sayText(1, "after");
+    std::vector<std::string> events;
+    while (events.size() < 3 && engine.receive(datagram)) {
+        CHECK(datagram.size() <= 1100);
+        for (const std::string& record : FrameRecords(datagram)) {
+            if (record[0] != MSG_TYPE_FRAGMENT) {
+                events.push_back(record);
+            }
+            else if (reassembler.add(record.data() + 1, record.size() - 1, event)) {
+                events.push_back(event);
+            }
+        }
+    }
+    // Lanes interleave by weight, so only the set of events is fixed
+    std::sort(events.begin(), events.end());
+    std::vector<std::string> expected = {
+        Tagged(MSG_TYPE_CHAT, "after"), Tagged(MSG_TYPE_CHAT, "before"), Tagged(MSG_TYPE_STUFF, text) };
+    CHECK(events == expected);
+    CHECK(reassembler.pending() == 0);
+    CHECK(ForwarderStats::Get(g_stats.fragments) >= (uint64_t)pieces + 5);
+
+    engine.setCvar(CVAR_PROTOCOL, "1");
+    engine.setCvar(CVAR_FRAME_MTU, "1400");
+    Apply(engine);
+}
+
+static uint32_t SequenceOf(const std::string& datagram) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(datagram.data());
+    return datagram.size() < SEQUENCE_HEADER_SIZE ? 0 :
+        (uint32_t)p[1] | ((uint32_t)p[2] << 8) | ((uint32_t)p[3] << 16) | ((uint32_t)p[4] << 24);
+}
+
+// [magic][NACK_TYPE][ack][count] { [first][length] }
+static std::string Nack(uint32_t ack, std::initializer_list<std::pair<uint32_t, uint16_t>> ranges) {
+    std::string nack = { (char)SEQUENCE_MAGIC, (char)NACK_TYPE };
+    auto put = [&](uint32_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) nack += (char)(value >> (8 * i));
+    };
+    put(ack, 4);
+    put((uint32_t)ranges.size(), 1);
+    for (const auto& range : ranges) {
+        put(range.first, 4);
+        put(range.second, 2);
+    }
+    return nack;
+}
+
+// Records keep their order, stamps and request ids across many wraps; a full ring refuses the push
+static void TestCommandRing() {
+    static CommandRing ring;
+    std::mt19937 rng(11);
+    std::deque<std::pair<std::string, int64_t>> pending;
+    std::string text;
+    int64_t received = 0;
+    CommandRequest request;
+    auto popFront = [&]() {
+        CHECK(ring.pop(text, &received, &request) && text == pending.front().first &&
+            received == pending.front().second && request.id == (uint32_t)received * 3);
+        pending.pop_front();
+    };
+    for (int64_t i = 0; i < 20000; i++) {
+        std::string command(std::uniform_int_distribution<size_t>(0, MAX_COMMAND_SIZE - 1)(rng), (char)('a' + i % 26));
+        CommandRequest pushed;
+        pushed.id = (uint32_t)i * 3;
+        if (!ring.push(command.data(), command.size(), i, pushed)) {
+            CHECK(pending.size() * (MAX_COMMAND_SIZE + 32) > COMMAND_RING_BYTES / 2);
+            while (!pending.empty()) popFront();
+            CHECK(ring.empty() && ring.push(command.data(), command.size(), i, pushed));
+        }
+        pending.emplace_back(command, i);
+        if (i % 3 == 0) popFront();
+    }
+    while (!pending.empty()) popFront();
+    CHECK(!ring.pop(text, nullptr));
+}
+
+// A SYS flood against CHAT in one SendQueue: CHAT loses nothing and waits at most one SYS
+// turn per CHAT turn, the drop-oldest SYS lane keeps the newest records, and the
+// drop-newest GAME lane keeps the oldest
+static void TestLanes() {
+    static SendQueue queue;
+    CHECK(queue.init(MIN_QUEUE_BYTES));
+    const int chatLane = MSG_TYPE_CHAT - MSG_TYPE_CHAT, gameLane = MSG_TYPE_GAME - MSG_TYPE_CHAT;
+    const int sysLane = MSG_TYPE_SYS - MSG_TYPE_CHAT;
+    const int chatWeight = 8, sysWeight = 2;
+    queue.configureLane(chatLane, MIN_QUEUE_BYTES, false, chatWeight);
+    queue.configureLane(gameLane, MIN_QUEUE_BYTES, false, 1);
+    queue.configureLane(sysLane, MIN_QUEUE_BYTES, true, sysWeight);
+
+    auto body = [](const char* kind, int seq) {
+        char text[128];
+        snprintf(text, sizeof(text), "%s %05d %0100d", kind, seq, 0);
+        return std::string(text);
+    };
+    auto seqOf = [](const std::string& record) { return atoi(record.c_str() + 1 + 4); };
+    const int chatCount = 64, sysPerChat = 20;
+    for (int i = 0; i < chatCount; i++) {
+        std::string chat = body("cht", i);
+        CHECK(queue.push(MSG_TYPE_CHAT, chat.data(), chat.size()));
+        for (int j = 0; j < sysPerChat; j++) {
+            std::string sys = body("sys", i * sysPerChat + j);
+            CHECK(queue.push(MSG_TYPE_SYS, sys.data(), sys.size()));   // evicts instead of failing
+        }
+    }
+
+    char out[MAX_RECORD_SIZE];
+    size_t len;
+    int chatSeen = 0, sysSeen = 0, lastSys = -1;
+    bool sysContiguous = true;
+    while (queue.pop(out, sizeof(out), len)) {
+        std::string record(out, len);
+        if (out[0] == MSG_TYPE_CHAT) {
+            CHECK(seqOf(record) == chatSeen);
+            // CHAT's k-th record waits behind at most one SYS turn per CHAT turn before it
+            CHECK(sysSeen <= (chatSeen / chatWeight + 1) * sysWeight);
+            chatSeen++;
+        }
+        else {
+            CHECK(out[0] == MSG_TYPE_SYS);
+            int seq = seqOf(record);
+            sysContiguous = sysContiguous && (lastSys < 0 || seq == lastSys + 1);
+            lastSys = seq;
+            sysSeen++;
+        }
+    }
+    CHECK(chatSeen == chatCount);
+    // Eviction took the oldest SYS records: the survivors are the newest, in order
+    CHECK(sysContiguous && lastSys == chatCount * sysPerChat - 1);
+    CHECK(sysSeen > 0 && sysSeen < chatCount * sysPerChat);
+
+    // Drop-newest: once the budget is spent pushes fail and the queued records stay
+    int kept = 0;
+    for (int i = 0; i < 1000; i++) {
+        std::string game = body("gam", i);
+        if (!queue.push(MSG_TYPE_GAME, game.data(), game.size())) {
+            break;
+        }
+        kept++;
+    }
+    CHECK(kept > 0 && kept < 1000);
+    std::string late = body("gam", 9999);
+    CHECK(!queue.push(MSG_TYPE_GAME, late.data(), late.size()));
+    for (int i = 0; i < kept; i++) {
+        CHECK(queue.pop(out, sizeof(out), len) && out[0] == MSG_TYPE_GAME && seqOf(std::string(out, len)) == i);
+    }
+    CHECK(!queue.pop(out, sizeof(out), len));
+}
+
+// Fake time for CommandScheduler: ClientCmd costs g_commandCost, frames are moved along by hand
+static std::chrono::steady_clock::time_point g_fakeNow;
+static std::chrono::microseconds g_commandCost(0);
+static std::vector<std::string> g_scheduled;
+
+static std::chrono::steady_clock::time_point FakeNow() { return g_fakeNow; }
+
+static void RecordClientCmd(const char* command) {
+    g_scheduled.push_back(command);
+    g_fakeNow += g_commandCost;
+}
+
+// Per-frame count and time budgets, the token bucket and urgent commands, without the reactor
+static void TestCommandScheduler() {
+    void (*clientCmd)(const char*) = g_engine.ClientCmd;
+    g_engine.ClientCmd = RecordClientCmd;
+    CommandScheduler scheduler(FakeNow);
+    ConfigSnapshot cfg;
+    cfg.commandsPerFrame = 2;
+    cfg.commandFrameUs = 0;
+    cfg.commandRate = 0.0;
+    cfg.commandBurst = 1.0;
+    auto push = [](const char* text, bool urgent) { g_messageQueue.push(text, strlen(text), urgent); };
+    auto frame = [&](std::chrono::milliseconds advance) {
+        g_fakeNow += advance;
+        g_scheduled.clear();
+        scheduler.runFrame(cfg);
+        return g_scheduled;
+    };
+
+    // cf_cmd_per_frame, with urgent commands ahead of older normal ones
+    push("say 1", false);
+    push("say 2", false);
+    push("say 3", false);
+    push("kick a", true);
+    CHECK((frame(std::chrono::milliseconds(16)) == std::vector<std::string>{ "kick a\n", "say 1\n" }));
+    CHECK((frame(std::chrono::milliseconds(16)) == std::vector<std::string>{ "say 2\n", "say 3\n" }));
+    CHECK(frame(std::chrono::milliseconds(16)).empty());
+
+    // cf_cmd_frame_us: commands of 60 us each stop once 100 us are spent; at least one always runs
+    cfg.commandsPerFrame = 10;
+    cfg.commandFrameUs = 100;
+    g_commandCost = std::chrono::microseconds(60);
+    for (const char* text : { "a", "b", "c", "d" }) push(text, false);
+    CHECK((frame(std::chrono::milliseconds(16)) == std::vector<std::string>{ "a\n", "b\n" }));
+    CHECK(scheduler.lastFrameUs() == 120);
+    cfg.commandFrameUs = 10;
+    CHECK((frame(std::chrono::milliseconds(16)) == std::vector<std::string>{ "c\n" }));
+    CHECK((frame(std::chrono::milliseconds(16)) == std::vector<std::string>{ "d\n" }));
+    cfg.commandFrameUs = 0;
+    g_commandCost = std::chrono::microseconds(0);
+
+    // Bucket of 3 refilled at 10/s: a burst of 3, then one per 100 ms; urgent commands skip it
+    cfg.commandRate = 10.0;
+    cfg.commandBurst = 3.0;
+    for (int i = 0; i < 8; i++) push("say x", false);
+    frame(std::chrono::seconds(1));   // refills the bucket to the burst
+    CHECK(g_scheduled.size() == 3);
+    CHECK(frame(std::chrono::milliseconds(50)).empty());
+    CHECK(frame(std::chrono::milliseconds(50)).size() == 1);
+    push("! stop", false);
+    push("stop", true);
+    CHECK((frame(std::chrono::milliseconds(10)) == std::vector<std::string>{ "stop\n" }));
+    CHECK(frame(std::chrono::milliseconds(100)).size() == 1);
+    CHECK(frame(std::chrono::milliseconds(1000)).size() == 3);   // capped by the burst
+    CHECK((frame(std::chrono::milliseconds(1000)) == std::vector<std::string>{ "! stop\n" }));  // the prefix is parsed on receipt, not here
+    CHECK(g_messageQueue.size() == 0);
+
+    g_engine.ClientCmd = clientCmd;
+}
+
+// Wraparound and eviction: whatever find() returns is the newest run of datagrams, intact
+static void TestRetransmitRing() {
+    RetransmitRing ring;
+    ring.reset(MIN_RETRANSMIT_BYTES);
+    std::mt19937 rng(7);
+    std::vector<std::string> stored;
+    for (uint32_t seq = 1; seq <= 2000; seq++) {
+        std::string datagram(std::uniform_int_distribution<size_t>(1, MAX_FRAME_MTU / 4)(rng), (char)seq);
+        char* out = ring.append(seq, datagram.size());
+        CHECK(out != nullptr);
+        if (out) memcpy(out, datagram.data(), datagram.size());
+        stored.push_back(datagram);
+    }
+
+    size_t len = 0, bytes = 0;
+    uint32_t oldest = 2000;
+    for (uint32_t seq = 2000; seq >= 1; seq--) {
+        const char* data = ring.find(seq, len);
+        if (!data) break;
+        CHECK(std::string(data, len) == stored[seq - 1]);
+        bytes += len;
+        oldest = seq;
+    }
+    CHECK(bytes <= MIN_RETRANSMIT_BYTES && bytes + 2 * MAX_FRAME_MTU / 4 > MIN_RETRANSMIT_BYTES / 2);
+    for (uint32_t seq = 1; seq < oldest; seq++) {
+        CHECK(ring.find(seq, len) == nullptr);
+    }
+    CHECK(ring.find(2001, len) == nullptr);
+}
+
+static void TestReliable(FakeEngine& engine) {
+    engine.setCvar(CVAR_RELIABLE, "1");
+    Apply(engine);
+
+    // Consecutive sequence numbers ahead of the unchanged v1 datagram
+    const char* lines[] = { "r1\n", "r2\n", "r3\n" };
+    std::string sent[3];
+    for (int i = 0; i < 3; i++) {
+        engine.print(lines[i]);
+        CHECK(engine.receive(sent[i]));
+        CHECK(!sent[i].empty() && (unsigned char)sent[i][0] == SEQUENCE_MAGIC);
+        CHECK(sent[i].substr(SEQUENCE_HEADER_SIZE) == Tagged(MSG_TYPE_NET, lines[i]));
+    }
+    uint32_t first = SequenceOf(sent[0]);
+    CHECK(SequenceOf(sent[1]) == first + 1 && SequenceOf(sent[2]) == first + 2);
+
+    // NACKed datagrams come back byte for byte; unknown ones are counted as missed
+    uint64_t missed = ForwarderStats::Get(g_stats.retransmitMissed);
+    CHECK(engine.sendCommand(Nack(first, { { first + 1, 2 }, { first + 1000, 1 } })));
+    std::string resent;
+    CHECK(engine.receive(resent) && resent == sent[1]);
+    CHECK(engine.receive(resent) && resent == sent[2]);
+    for (int wait = 0; wait < 100 && ForwarderStats::Get(g_stats.retransmitMissed) == missed; wait++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1)); // counted after the resends went out
+    }
+    CHECK(ForwarderStats::Get(g_stats.retransmitMissed) == missed + 1);
+    CHECK(g_nacks.ack() == first);
+
+    // Feedback is never run as a console command
+    CHECK(RunCommands(engine, 1).empty());
+
+    engine.setCvar(CVAR_RELIABLE, "0");
+    Apply(engine);
+    engine.print("plain\n");
+    CHECK(Next(engine) == Tagged(MSG_TYPE_NET, "plain\n"));
+}
+
+// A second receiver gets the cf_destinations copy, filtered by its tag mask
+static void TestDestinations(FakeEngine& engine) {
+    UdpSocket extra;
+    WakeEvent extraWake;
+    CHECK(extra.open() && extra.bind(0) && extra.watch());
+    std::string address = "127.0.0.1:" + std::to_string(extra.localPort());
+    CHECK(engine.command(("cf_dest_add " + address + " 1").c_str()));
+    CHECK(g_config.current().destinationCount == 1 && g_config.current().destinations[0].tags == 1);
+    CHECK(engine.command("cf_dest_add nonsense"));
+    CHECK(g_config.current().destinationCount == 1);
+    Apply(engine);
+
+    // v1: the same datagram for a CHAT event, nothing for NET
+    std::string datagram;
+    engine.sayText(1, "%s: %s", { "Player", "to both" });
+    engine.print("primary only\n");
+    std::vector<std::string> events = { Next(engine), Next(engine) };
+    std::sort(events.begin(), events.end());
+    CHECK((events == std::vector<std::string>{
+        Tagged(MSG_TYPE_CHAT, "Player: to both"), Tagged(MSG_TYPE_NET, "primary only\n") }));
+    CHECK(ReceiveDatagram(extra, extraWake, datagram) && datagram == Tagged(MSG_TYPE_CHAT, "Player: to both"));
+    CHECK(!ReceiveDatagram(extra, extraWake, datagram, 100));
+
+    // v2: the extra target gets a frame of its own holding only its tags
+    engine.setCvar(CVAR_PROTOCOL, "2");
+    engine.setCvar(CVAR_FLUSH_US, "20000");
+    Apply(engine);
+    engine.print("framed net\n");
+    engine.sayText(1, "%s: %s", { "Player", "framed chat" });
+    std::vector<std::string> records;
+    while (records.size() < 2 && engine.receive(datagram)) {
+        for (const std::string& record : FrameRecords(datagram)) {
+            records.push_back(record);
+        }
+    }
+    std::sort(records.begin(), records.end());
+    CHECK((records == std::vector<std::string>{
+        Tagged(MSG_TYPE_CHAT, "Player: framed chat"), Tagged(MSG_TYPE_NET, "framed net\n") }));
+    CHECK(ReceiveDatagram(extra, extraWake, datagram) &&
+        FrameRecords(datagram) == std::vector<std::string>{ Tagged(MSG_TYPE_CHAT, "Player: framed chat") });
+
+    engine.takeConsole();
+    CHECK(engine.command("cf_dest_list"));
+    std::vector<std::string> lines = engine.takeConsole();
+    CHECK(lines.size() == 2 && lines[1].find(address + " tags=1 datagrams=2/") != std::string::npos);
+
+    CHECK(engine.command(("cf_dest_remove " + address).c_str()));
+    CHECK(g_config.current().destinationCount == 0);
+    engine.setCvar(CVAR_PROTOCOL, "1");
+    engine.setCvar(CVAR_FLUSH_US, "2000");
+    Apply(engine);
+    engine.sayText(1, "%s: %s", { "Player", "primary again" });
+    CHECK(Next(engine) == Tagged(MSG_TYPE_CHAT, "Player: primary again"));
+    CHECK(!ReceiveDatagram(extra, extraWake, datagram, 100));
+}
+
+// A hostname is resolved off the sender thread and published like any other change
+static void TestHostname(FakeEngine& engine) {
+    engine.setCvar(CVAR_SERVER_IP, "localhost");
+    Apply(engine);
+    ResolvedDestination dest;
+    for (int wait = 0; wait < 1000 && !g_destination.refresh(dest); wait++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(dest.valid && dest.addr.sin_addr.s_addr == htonl(INADDR_LOOPBACK));
+    engine.print("by name\n");
+    CHECK(Next(engine) == Tagged(MSG_TYPE_NET, "by name\n"));
+
+    engine.setCvar(CVAR_SERVER_IP, "127.0.0.1");
+    Apply(engine);
+}
+
+// Leftovers of an earlier run would be picked up and replayed; at the end of a test this
+// also takes the directory Spool::configure created
+static void RemoveSpool(const std::string& directory) {
+    for (int slot = 0; slot < 8; slot++) {
+        char name[32];
+        snprintf(name, sizeof(name), "/spool_%04d.seg", slot);
+        RemoveFile((directory + name).c_str());
+    }
+    RemoveEmptyDirectory(directory.c_str());
+}
+
+// Append order survives rotation and a reopen; a full spool overwrites its oldest segment
+static void TestSpoolSegments() {
+    const std::string directory = "cf_test_spool_segments";
+    RemoveSpool(directory);
+    std::unique_ptr<Spool> spool(new Spool);
+    CHECK(spool->configure(directory.c_str(), MIN_SPOOL_BYTES));
+    std::string body(1000, 'b');
+    uint32_t appended = 0;
+    while (spool->lost() == 0) {
+        memcpy(&body[0], &appended, sizeof(appended));
+        CHECK(spool->append(MSG_TYPE_NET, body.data(), body.size()));
+        appended++;
+    }
+    CHECK(spool->pendingBytes() <= MIN_SPOOL_BYTES);
+
+    char record[MAX_RECORD_SIZE];
+    size_t len = 0;
+    uint32_t first = 0;
+    CHECK(spool->peek(record, sizeof(record), len) && len == 1 + body.size() && record[0] == MSG_TYPE_NET);
+    memcpy(&first, record + 1, sizeof(first));
+    CHECK(first == spool->lost());
+    spool->consume();
+
+    // Reopened: replay resumes after the consumed record
+    spool.reset(new Spool);
+    CHECK(spool->configure(directory.c_str(), MIN_SPOOL_BYTES));
+    for (uint32_t expected = first + 1; expected < appended; expected++) {
+        uint32_t index = 0;
+        if (!spool->peek(record, sizeof(record), len)) {
+            CHECK(false);
+            break;
+        }
+        memcpy(&index, record + 1, sizeof(index));
+        CHECK(index == expected);
+        spool->consume();
+    }
+    CHECK(!spool->peek(record, sizeof(record), len));
+    CHECK(spool->empty());
+    spool->close();
+    RemoveSpool(directory);
+}
+
+static void TestSpool(FakeEngine& engine) {
+    const std::string directory = "cf_test_spool";
+    RemoveSpool(directory);
+    engine.setCvar(CVAR_SPOOL, "1");
+    engine.setCvar(CVAR_SPOOL_PATH, directory.c_str());
+    engine.setCvar(CVAR_SPOOL_AUTO, "0");
+    std::string port = std::to_string(engine.receiverPort());
+    engine.setCvar(CVAR_SERVER_PORT, "0");
+    Apply(engine);
+
+    // Receiver unreachable: events go to the spool instead of being dropped
+    uint64_t spooled = ForwarderStats::Get(g_stats.spooled);
+    const char* lines[] = { "s1\n", "s2\n", "s3\n" };
+    for (const char* line : lines) {
+        engine.print(line);
+    }
+    for (int wait = 0; wait < 100 && ForwarderStats::Get(g_stats.spooled) < spooled + 3; wait++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(ForwarderStats::Get(g_stats.spooled) == spooled + 3);
+
+    // With cf_spool_auto 0 the receiver asks for the replay once it is back
+    engine.setCvar(CVAR_SERVER_PORT, port.c_str());
+    Apply(engine);
+    std::string datagram;
+    CHECK(!engine.receive(datagram, 100));
+    CHECK(engine.command("cf_spool_replay"));
+    for (const char* line : lines) {
+        CHECK(Next(engine) == Tagged(MSG_TYPE_NET, line));
+    }
+    for (int wait = 0; wait < 100 && !g_spool.empty(); wait++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(g_spool.empty());
+
+    // v2: frames that fail to go out spool a fragmented event whole, not its pieces
+    std::string text;
+    for (int i = 0; text.size() < 3000; i++) {
+        text += "line " + std::to_string(i) + " of a long status dump\n";
+    }
+    engine.setCvar(CVAR_PROTOCOL, "2");
+    engine.setCvar(CVAR_FRAME_MTU, "1100");
+    engine.setCvar(CVAR_FLUSH_US, "2000");
+    engine.setCvar(CVAR_SERVER_PORT, "0");
+    Apply(engine);
+    spooled = ForwarderStats::Get(g_stats.spooled);
+    engine.print(text.c_str());
+    engine.print("s4\n");
+    for (int wait = 0; wait < 100 && ForwarderStats::Get(g_stats.spooled) < spooled + 2; wait++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(ForwarderStats::Get(g_stats.spooled) == spooled + 2);
+
+    engine.setCvar(CVAR_SERVER_PORT, port.c_str());
+    Apply(engine);
+    CHECK(engine.command("cf_spool_replay"));
+    FragmentReassembler reassembler;
+    std::vector<std::string> events;
+    std::string event;
+    while (events.size() < 2 && engine.receive(datagram)) {
+        for (const std::string& record : FrameRecords(datagram)) {
+            if (record[0] != MSG_TYPE_FRAGMENT) {
+                events.push_back(record);
+            }
+            else if (reassembler.add(record.data() + 1, record.size() - 1, event)) {
+                events.push_back(event);
+            }
+        }
+    }
+    CHECK(events.size() == 2 && events[0] == Tagged(MSG_TYPE_NET, text) && events[1] == Tagged(MSG_TYPE_NET, "s4\n"));
+    CHECK(reassembler.pending() == 0);
+
+    engine.setCvar(CVAR_PROTOCOL, "1");
+    engine.setCvar(CVAR_FRAME_MTU, "1400");
+    engine.setCvar(CVAR_SPOOL, "0");
+    engine.setCvar(CVAR_SPOOL_AUTO, "1");
+    Apply(engine);
+    RemoveSpool(directory);
+}
+
+static void TestDedup(FakeEngine& engine) {
+    engine.setCvar(CVAR_DEDUP, "1");
+    engine.setCvar(CVAR_DEDUP_WINDOW, "5000");
+    Apply(engine);
+
+    engine.print("Same text\n");
+    engine.debugString("  same TEXT\n");
+    engine.print("Different text\n");
+    CHECK(Next(engine) == Tagged(MSG_TYPE_NET, "Same text\n"));
+    CHECK(Next(engine) == Tagged(MSG_TYPE_NET, "Different text\n"));
+    CHECK(g_dedup.hits() == 1);
+
+    engine.setCvar(CVAR_DEDUP, "0");
+    Apply(engine);
+}
+
+// Overlapping patterns, case folding and the include/exclude precedence per tag
+static void TestFilterRules() {
+    FilterSet filter;
+    std::string error;
+    CHECK(filter.addRule("# comment", error) && filter.addRule("   ", error));
+    CHECK(filter.addRule("chat + hello", error));
+    CHECK(filter.addRule("chat - hello world", error));
+    CHECK(filter.addRule("net,sys - Precache", error));
+    CHECK(filter.addRule("* - she", error));
+    CHECK(filter.addRule("2 + he", error));
+    CHECK(!filter.addRule("chat hello", error));
+    CHECK(!filter.addRule("voice + hello", error));
+    CHECK(!filter.addRule("chat +", error));
+    filter.compile();
+    CHECK(filter.size() == 5);
+
+    auto allows = [&filter](char tag, const char* text) { return filter.allows(tag, text, strlen(text)); };
+    CHECK(allows(MSG_TYPE_CHAT, "well HELLO there"));
+    CHECK(!allows(MSG_TYPE_CHAT, "no greeting"));
+    CHECK(!allows(MSG_TYPE_CHAT, "Hello World"));
+    CHECK(!allows(MSG_TYPE_NET, "precache: models/player.mdl\n"));
+    CHECK(allows(MSG_TYPE_NET, "Connected to server\n"));
+    CHECK(!allows(MSG_TYPE_STUFF, "ushers in"));       // "she" inside "ushers"
+    CHECK(allows(MSG_TYPE_GAME, "the end"));
+    CHECK(!allows(MSG_TYPE_GAME, "nothing"));
+    CHECK(!allows(MSG_TYPE_GAME, "then she left"));     // exclusions win over inclusions
+    // "Hello World" is included on "hello" before "hello world" excludes it
+    CHECK(filter.rule(0).hits.load() == 2 && filter.rule(1).hits.load() == 1);
+    CHECK(filter.rule(2).hits.load() == 1 && filter.rule(3).hits.load() == 2 && filter.rule(4).hits.load() == 2);
+}
+
+// Filtered events are dropped before the lanes, and cf_filter_reload swaps the rules in
+static void TestFilter(FakeEngine& engine) {
+    const std::string path = "cf_test_filter.txt";
+    FILE* file = fopen(path.c_str(), "w");
+    CHECK(file != nullptr);
+    if (!file) return;
+    fputs("net - precache\nchat + !\n", file);
+    fclose(file);
+    engine.setCvar(CVAR_FILTER_FILE, path.c_str());
+    engine.setCvar(CVAR_FILTER, "1");
+    Apply(engine);
+
+    uint64_t enqueued = ForwarderStats::Get(g_stats.lanes[SendQueue::LaneOf(MSG_TYPE_NET)].enqueued);
+    engine.print("Precache models/a.mdl\n");
+    engine.sayText(1, "%s: %s", { "Player", "quiet" });
+    engine.sayText(1, "%s: %s", { "Player", "loud!" });
+    engine.print("kept\n");
+    std::vector<std::string> events = { Next(engine), Next(engine) };
+    std::sort(events.begin(), events.end());
+    CHECK((events == std::vector<std::string>{
+        Tagged(MSG_TYPE_CHAT, "Player: loud!"), Tagged(MSG_TYPE_NET, "kept\n") }));
+    CHECK(ForwarderStats::Get(g_stats.lanes[SendQueue::LaneOf(MSG_TYPE_NET)].enqueued) == enqueued + 1);
+    CHECK(ForwarderStats::Get(g_stats.lanes[SendQueue::LaneOf(MSG_TYPE_NET)].dropped[DROP_FILTERED]) == 1);
+
+    file = fopen(path.c_str(), "w");
+    CHECK(file != nullptr);
+    if (!file) return;
+    fputs("net - kept\n", file);
+    fclose(file);
+    CHECK(engine.command("cf_filter_reload"));
+    engine.print("kept\n");
+    engine.print("precache now passes\n");
+    CHECK(Next(engine) == Tagged(MSG_TYPE_NET, "precache now passes\n"));
+
+    engine.takeConsole();
+    CHECK(engine.command("cf_filter_stats"));
+    std::vector<std::string> lines = engine.takeConsole();
+    CHECK(lines.size() == 2 && lines[1].find("- kept hits=1") != std::string::npos);
+
+    engine.setCvar(CVAR_FILTER, "0");
+    Apply(engine);
+    engine.print("kept\n");
+    CHECK(Next(engine) == Tagged(MSG_TYPE_NET, "kept\n"));
+    RemoveFile(path.c_str());
+}
+
+// [field][varint length][value] entries of a structured event body, in order
+static std::vector<std::pair<int, std::string>> EventFieldList(const std::string& body) {
+    std::vector<std::pair<int, std::string>> fields;
+    for (size_t pos = 0; pos < body.size(); ) {
+        int field = (unsigned char)body[pos++];
+        size_t len = 0;
+        int shift = 0;
+        unsigned char byte;
+        do {
+            byte = pos < body.size() ? (unsigned char)body[pos++] : 0;
+            len |= (size_t)(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        fields.emplace_back(field, body.substr(pos, len));
+        pos += len;
+    }
+    return fields;
+}
+
+static uint64_t VarintValue(const std::string& value) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < value.size(); i++) {
+        result |= (uint64_t)((unsigned char)value[i] & 0x7F) << (7 * i);
+    }
+    return result;
+}
+
+// cf_encoding 1 keeps client index, msg_dest, format key and arguments apart
+static void TestStructuredEvents(FakeEngine& engine) {
+    engine.setCvar(CVAR_ENCODING, "1");
+    Apply(engine);
+
+    engine.sayText(7, "%s: %s", { "\x02Name: with colon", "hi\x07 there" });
+    std::string event = Next(engine);
+    CHECK(!event.empty() && event[0] == (MSG_TYPE_CHAT | MSG_STRUCTURED_FLAG));
+    std::vector<std::pair<int, std::string>> fields = EventFieldList(event.substr(1));
+    CHECK(fields.size() == 6);
+    if (fields.size() != 6) return;
+    uint64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    CHECK(fields[0].first == EVENT_TIME && VarintValue(fields[0].second) <= now &&
+        VarintValue(fields[0].second) + 10000000 > now);
+    CHECK(fields[1].first == EVENT_SEQ);
+    uint64_t seq = VarintValue(fields[1].second);
+    CHECK(fields[2].first == EVENT_CLIENT && VarintValue(fields[2].second) == 7);
+    CHECK(fields[3] == std::make_pair((int)EVENT_KEY, std::string("%s: %s")));
+    CHECK(fields[4] == std::make_pair((int)EVENT_ARG, std::string("\x02Name: with colon")));
+    CHECK(fields[5] == std::make_pair((int)EVENT_ARG, std::string("hi there")));
+
+    engine.textMsg(3, "#Game_joined_game", { "Bob" });
+    fields = EventFieldList(Next(engine).substr(1));
+    CHECK(fields.size() == 5 && VarintValue(fields[1].second) == seq + 1);
+    CHECK(fields.size() == 5 && fields[2].first == EVENT_DEST && VarintValue(fields[2].second) == 3);
+    CHECK(fields.size() == 5 && fields[3].second == "#Game_joined_game" && fields[4].second == "Bob");
+
+    engine.print("Server says hi\n");
+    event = Next(engine);
+    CHECK(!event.empty() && event[0] == (MSG_TYPE_NET | MSG_STRUCTURED_FLAG));
+    fields = EventFieldList(event.substr(1));
+    CHECK(fields.size() == 3 && VarintValue(fields[1].second) == seq + 2);
+    CHECK(fields.size() == 3 && fields[2] == std::make_pair((int)EVENT_TEXT, std::string("Server says hi\n")));
+
+    engine.setCvar(CVAR_ENCODING, "0");
+    Apply(engine);
+}
+
+static void TestInboundCommands(FakeEngine& engine) {
+    // The reactor binds asynchronously; repeat the first command until it lands
+    std::vector<std::string> executed;
+    for (int attempt = 0; attempt < 50 && executed.empty(); attempt++) {
+        engine.sendCommand("echo ready");
+        executed = RunCommands(engine, 1);
+    }
+    CHECK(!executed.empty() && executed[0] == "echo ready\n");
+    RunCommands(engine, 100);  // flush retries that arrived late
+    engine.takeCommands();
+
+    // Urgent commands run first; at most cf_cmd_per_frame per frame
+    engine.setCvar(CVAR_CMD_PER_FRAME, "1");
+    Apply(engine);
+    engine.sendCommand("  say one  \n");
+    engine.sendCommand("say two");
+    engine.sendCommand("! kick bot");
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (g_messageQueue.size() < 3 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(g_messageQueue.size() == 3);
+
+    engine.frame();
+    CHECK(engine.takeCommands() == std::vector<std::string>{ "kick bot\n" });
+    executed = RunCommands(engine, 2);
+    CHECK((executed == std::vector<std::string>{ "say one\n", "say two\n" }));
+}
+
+// Several commands per datagram, by line or length-prefixed; overlong ones are dropped
+static void TestCommandBatches(FakeEngine& engine) {
+    engine.setCvar(CVAR_CMD_PER_FRAME, "10");
+    Apply(engine);
+    engine.takeCommands();
+
+    engine.sendCommand("say a\n\n  say b  \r\n! kick c");
+    std::vector<std::string> executed = RunCommands(engine, 3);
+    std::sort(executed.begin(), executed.end());
+    CHECK((executed == std::vector<std::string>{ "kick c\n", "say a\n", "say b\n" }));
+
+    std::string longOk = "echo " + std::string(MAX_COMMAND_SIZE - 7, 'x');
+    std::string tooLong = "echo " + std::string(MAX_COMMAND_SIZE, 'y');
+    std::string batch(1, (char)COMMAND_BATCH_MAGIC);
+    for (const std::string& command : { std::string("alias a \"b\nc\""), longOk, tooLong, std::string("say end") }) {
+        for (size_t value = command.size(); ; value >>= 7) {
+            batch += (char)((value & 0x7F) | (value >> 7 ? 0x80 : 0));
+            if (!(value >> 7)) break;
+        }
+        batch += command;
+    }
+    uint64_t dropped = ForwarderStats::Get(g_stats.commandsDropped);
+    engine.sendCommand(batch);
+    executed = RunCommands(engine, 3);
+    CHECK((executed == std::vector<std::string>{ "alias a \"b\nc\"\n", longOk + "\n", "say end\n" }));
+    CHECK(ForwarderStats::Get(g_stats.commandsDropped) == dropped + 1);
+
+    engine.setCvar(CVAR_CMD_PER_FRAME, "1");
+    Apply(engine);
+}
+
+// A request runs alone, and what the game thread prints until the next frame comes back
+// to the sender under its id
+static void TestCommandReplies(FakeEngine& engine) {
+    engine.setCvar(CVAR_CMD_PER_FRAME, "10");
+    engine.setCvar(CVAR_CMD_REPLY_MS, "100");
+    Apply(engine);
+    engine.takeCommands();
+
+    auto request = [](uint32_t id, const char* command) {
+        std::string datagram(1, (char)REQUEST_MAGIC);
+        for (int i = 0; i < 4; i++) datagram += (char)(id >> (8 * i));
+        return datagram + command;
+    };
+    // The window closes on a later frame; frames keep coming until the reply is out
+    auto awaitReply = [&engine](std::string& reply) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(COMMAND_REPLY_MAX_MS + 1000);
+        while (std::chrono::steady_clock::now() < deadline) {
+            engine.frame();
+            if (engine.receiveReply(reply, 10)) {
+                return true;
+            }
+        }
+        return false;
+    };
+    engine.sendCommand("say before");
+    engine.sendCommand(request(0x01020304, "status"));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (g_messageQueue.size() < 2 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(g_messageQueue.size() == 2);
+
+    engine.frame();
+    CHECK(engine.takeCommands() == std::vector<std::string>{ "say before\n" });
+    engine.frame();
+    CHECK(engine.takeCommands() == std::vector<std::string>{ "status\n" });
+    // The engine runs the command: its output is printed on the game thread
+    engine.print("hostname: test\n");
+    std::thread([&engine]() { engine.print("from another thread\n"); }).join();
+    engine.debugString("not console output\n");
+    engine.conPrint("players: 1\x07\n");
+
+    std::string reply;
+    CHECK(awaitReply(reply));
+    CHECK(reply.size() >= REPLY_HEADER_SIZE && (unsigned char)reply[0] == REQUEST_MAGIC);
+    CHECK(reply.compare(1, 4, "\x04\x03\x02\x01", 4) == 0 && reply[5] == 0);
+    CHECK(reply.substr(REPLY_HEADER_SIZE) == "hostname: test\nplayers: 1\n");
+    CHECK(g_commandScheduler.replies() == 1);
+
+    // A server answer frames after the command's own frame still makes the reply
+    engine.sendCommand(request(7, "status"));
+    CHECK(RunCommands(engine, 1) == std::vector<std::string>{ "status\n" });
+    for (int i = 0; i < 5; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        engine.frame();
+    }
+    engine.print("map: de_dust2\n");
+    engine.frame();
+    CHECK(!engine.receiveReply(reply, 20));      // output just arrived: the window is still open
+    CHECK(awaitReply(reply));
+    CHECK(reply.compare(1, 4, "\x07\0\0\0", 4) == 0 && reply.substr(REPLY_HEADER_SIZE) == "map: de_dust2\n");
+    uint32_t runUs = 0;
+    for (int i = 0; i < 4; i++) runUs |= (uint32_t)(unsigned char)reply[10 + i] << (8 * i);
+    CHECK(runUs >= 150 * 1000);
+    CHECK(g_commandScheduler.replies() == 2);
+
+    // Id 0 is a plain command
+    engine.sendCommand(request(0, "say after"));
+    CHECK(RunCommands(engine, 1) == std::vector<std::string>{ "say after\n" });
+    CHECK(!engine.receiveReply(reply, 100));
+
+    while (engine.receive(reply, 100)) {}   // the printed lines went out as events too
+    engine.setCvar(CVAR_CMD_PER_FRAME, "1");
+    engine.setCvar(CVAR_CMD_REPLY_MS, "250");
+    Apply(engine);
+}
+
+// cf_listen_only: the reactor keeps reading commands while queued events wait for it to end
+static void TestListenOnly(FakeEngine& engine) {
+    engine.setCvar(CVAR_LISTEN_ONLY, "1");
+    Apply(engine);
+    engine.takeCommands();
+
+    engine.print("held back\n");
+    engine.sendCommand("say still listening");
+    CHECK(RunCommands(engine, 1) == std::vector<std::string>{ "say still listening\n" });
+    std::string datagram;
+    CHECK(!engine.receive(datagram, 100));
+
+    engine.setCvar(CVAR_LISTEN_ONLY, "0");
+    Apply(engine);
+    CHECK(Next(engine) == Tagged(MSG_TYPE_NET, "held back\n"));
+}
+
+// An idle reactor stays blocked: frames without a config change do not wake it
+static void TestIdleReactor(FakeEngine& engine) {
+    std::string datagram;
+    while (engine.receive(datagram, 100)) {}
+    uint64_t before = ForwarderStats::Get(g_stats.reactorWakeups);
+    for (int i = 0; i < 50; i++) {
+        engine.frame();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(ForwarderStats::Get(g_stats.reactorWakeups) - before <= 1);
+}
+
+static void TestConsoleCommands(FakeEngine& engine) {
+    engine.takeConsole();
+    CHECK(engine.command("cf_stats"));
+    std::vector<std::string> lines = engine.takeConsole();
+    CHECK(lines.size() == LANE_COUNT + 4);
+    CHECK(!lines.empty() && lines[0].find("CHAT enq=") != std::string::npos);
+    CHECK(ForwarderStats::Get(g_stats.lanes[0].sent) >= 3);
+    CHECK(ForwarderStats::Get(g_stats.commandsExecuted) >= 4);
+
+    CHECK(engine.command("cf_latency reset"));
+    CHECK(!engine.takeConsole().empty());
+    CHECK(!engine.command("cf_unknown"));
+}
+
+int main() {
+    TestCleanMessageKernels();
+    TestRetransmitRing();
+    TestCommandRing();
+    TestSpoolSegments();
+    TestFilterRules();
+    TestCommandScheduler();
+    TestLanes();
+
+    FakeEngine engine;
+    if (!engine.start()) {
+        fprintf(stderr, "fake engine failed to start\n");
+        return 1;
+    }
+    TestOutboundV1(engine);
+    TestDebugLines(engine);
+    TestDeferredMatchesSync(engine);
+    TestFramedV2(engine);
+    TestFragments(engine);
+    TestReliable(engine);
+    TestSpool(engine);
+    TestDestinations(engine);
+    TestHostname(engine);
+    TestDedup(engine);
+    TestFilter(engine);
+    TestStructuredEvents(engine);
+    TestInboundCommands(engine);
+    TestCommandBatches(engine);
+    TestCommandReplies(engine);
+    TestListenOnly(engine);
+    TestIdleReactor(engine);
+    TestConsoleCommands(engine);
+
+    // Shutdown wakes the blocked reactor at once, far below the old 500 ms receive timeout
+    auto stopStart = std::chrono::steady_clock::now();
+    engine.stop();
+    CHECK(std::chrono::steady_clock::now() - stopStart < std::chrono::milliseconds(50));
+
+    if (g_failures) {
+        fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("pipeline: all checks passed\n");
+    return 0;
+}
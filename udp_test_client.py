@@ -35,8 +35,40 @@ TAG_MAP = {
     0x14: "[NET] ",
     0x15: "[SYS] ",
     0x16: "[STUFF]",
+    0x17: "[STATS]",
 }
 
+# Protocol v2 (cf_protocol 2): [0xCF][version] + [tag][varint len][body]...
+FRAME_MAGIC   = 0xCF
+FRAME_VERSION = 2
+
+# Events larger than cf_frame_mtu: [0x18][tag][id u16 LE][index][count][piece]
+FRAGMENT_TAG = 0x18
+
+# cf_encoding 1: the tag has STRUCTURED_FLAG set and the body is a field list,
+# { [field][varint len][value] }..., with integer values as varints.
+STRUCTURED_FLAG = 0x20
+EVENT_TIME   = 1    # capture time, microseconds since the Unix epoch
+EVENT_SEQ    = 2    # event counter; a gap means the plugin dropped events
+EVENT_CLIENT = 3    # SayText sender's client index
+EVENT_DEST   = 4    # TextMsg msg_dest
+EVENT_KEY    = 5    # format string, e.g. #Game_joined_game
+EVENT_ARG    = 6    # one argument, repeated in order
+EVENT_TEXT   = 7    # text of a print/stufftext/debug event
+
+# cf_reliable 1: [0xCE][seq u32 LE] ahead of every datagram. Gaps are NACKed back to
+# SEND_PORT as [0xCE][0x01][ack u32][count] + count x [first u32][length u16].
+SEQUENCE_MAGIC = 0xCE
+NACK_TYPE      = 0x01
+NACK_INTERVAL  = 0.5    # seconds between repeated NACKs for a gap still open
+
+# Command requests: "?status" sends [0xCC][id u32 LE] + "status" and waits for
+# [0xCC][id u32][flags][wait us u32][run us u32] + the output the command printed.
+REQUEST_MAGIC   = 0xCC
+REPLY_HEADER    = 14
+REPLY_TRUNCATED = 0x01
+REPLY_TIMEOUT   = 3.0   # seconds; the output window closes within 2 s
+
 # ANSI Colors
 ANSI_RESET  = "\033[0m"
 ANSI_NORMAL = "\033[0m"       # 0x01
@@ -91,6 +123,166 @@ def is_duplicate(payload: bytes) -> bool:
         _dedup_buf.append((now, key))
         return False
 
+# ==============================================================================
+# PROTOCOL
+# ==============================================================================
+def decode_varint(data: bytes, pos: int):
+    """Decodes an unsigned LEB128 varint. Returns (value, new_pos)."""
+    value = 0
+    shift = 0
+    while True:
+        if pos >= len(data):
+            raise ValueError("truncated varint")
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, pos
+        shift += 7
+        if shift > 63:
+            raise ValueError("varint too long")
+
+def decode_datagram(data: bytes):
+    """
+    Yields (tag, payload) events from one datagram.
+    v1 packets carry a single [tag][body]; v2 frames carry many records.
+    """
+    if len(data) >= 2 and data[0] == FRAME_MAGIC:
+        if data[1] != FRAME_VERSION:
+            return
+        pos = 2
+        while pos < len(data):
+            tag = data[pos]
+            length, pos = decode_varint(data, pos + 1)
+            if pos + length > len(data):
+                raise ValueError("truncated record")
+            yield tag, data[pos:pos + length]
+            pos += length
+        return
+    yield data[0], data[1:]
+
+def decode_event(payload: bytes) -> dict:
+    """
+    Decodes a structured event body into a dict with 'time', 'seq', 'client', 'dest',
+    'key', 'args' and 'text' (absent fields are None; args is a list).
+    """
+    event = {"time": None, "seq": None, "client": None, "dest": None,
+             "key": None, "args": [], "text": None}
+    ints = {EVENT_TIME: "time", EVENT_SEQ: "seq", EVENT_CLIENT: "client", EVENT_DEST: "dest"}
+    pos = 0
+    while pos < len(payload):
+        field = payload[pos]
+        length, pos = decode_varint(payload, pos + 1)
+        if pos + length > len(payload):
+            raise ValueError("truncated field")
+        value = payload[pos:pos + length]
+        pos += length
+        if field in ints:
+            event[ints[field]] = decode_varint(value, 0)[0]
+        elif field == EVENT_KEY:
+            event["key"] = value
+        elif field == EVENT_ARG:
+            event["args"].append(value)
+        elif field == EVENT_TEXT:
+            event["text"] = value
+        # unknown fields are skipped
+    return event
+
+def event_text(event: dict) -> bytes:
+    """
+    The text the plugin would have sent with cf_encoding 0: each non-empty argument
+    replaces the next %s of the key, or is appended after a space once none are left.
+    """
+    if event["key"] is None:
+        return event["text"] or b""
+    key, out, cursor = event["key"], b"", 0
+    for arg in event["args"]:
+        if not arg:
+            continue
+        placeholder = key.find(b"%s", cursor)
+        if placeholder >= 0:
+            out += key[cursor:placeholder]
+            cursor = placeholder + 2
+        else:
+            out += key[cursor:]
+            cursor = len(key)
+            if out:
+                out += b" "
+        out += arg
+    return out + key[cursor:]
+
+# Fragment id -> (tag, count, {index: piece})
+_fragments: dict = {}
+
+def reassemble(payload: bytes):
+    """
+    Feeds one fragment body. Returns (tag, body) once every piece of its id arrived,
+    otherwise None.
+    """
+    if len(payload) < 5:
+        return None
+    tag, frag_id, index, count = payload[0], payload[1] | (payload[2] << 8), payload[3], payload[4]
+    if index >= count:
+        return None
+    entry = _fragments.get(frag_id)
+    if entry is None or entry[0] != tag or entry[1] != count:
+        # New id, or the 16-bit id wrapped onto a stale one
+        entry = (tag, count, {})
+        _fragments[frag_id] = entry
+    entry[2][index] = payload[5:]
+    if len(entry[2]) < count:
+        return None
+    del _fragments[frag_id]
+    return tag, b"".join(entry[2][i] for i in range(count))
+
+class SequenceTracker:
+    """
+    Receiver side of cf_reliable. Tracks the next expected sequence number and the gaps
+    below it; accept() returns False for a datagram that was already delivered.
+    """
+    def __init__(self):
+        self.expected = None
+        self.missing = set()
+        self.last_nack = 0.0
+
+    def accept(self, seq: int) -> bool:
+        if self.expected is None or seq == 1:
+            if self.expected is not None:
+                print("[INFO] Sequence restarted (plugin or destination changed)")
+            self.expected = seq + 1
+            self.missing.clear()
+            return True
+        if seq >= self.expected:
+            if seq > self.expected:
+                print(f"{ANSI_DIM}[LOSS] Missing {seq - self.expected} datagram(s) "
+                      f"#{self.expected}-#{seq - 1}, requesting retransmit{ANSI_RESET}")
+                self.missing.update(range(self.expected, seq))
+                self.last_nack = 0.0
+            self.expected = seq + 1
+            return True
+        if seq in self.missing:
+            self.missing.discard(seq)
+            return True
+        return False
+
+    def nack(self):
+        """Builds a NACK for the open gaps, or None if there is nothing to request."""
+        if not self.missing or time.monotonic() - self.last_nack < NACK_INTERVAL:
+            return None
+        self.last_nack = time.monotonic()
+        ranges = []
+        for seq in sorted(self.missing):
+            if ranges and seq == ranges[-1][0] + ranges[-1][1] and ranges[-1][1] < 0xFFFF:
+                ranges[-1][1] += 1
+            else:
+                ranges.append([seq, 1])
+        ranges = ranges[:32]
+        ack = min(self.missing) - 1
+        packet = bytes([SEQUENCE_MAGIC, NACK_TYPE]) + ack.to_bytes(4, "little") + bytes([len(ranges)])
+        for first, length in ranges:
+            packet += first.to_bytes(4, "little") + length.to_bytes(2, "little")
+        return packet
+
 # ==============================================================================
 # ANSI / DISPLAY
 # ==============================================================================
@@ -145,29 +337,59 @@ def listener_thread(stop_event: threading.Event):
         print(f"[ERROR] Failed to bind listener: {e}")
         return
 
+    sequence = SequenceTracker()
     while not stop_event.is_set():
         try:
-            data, addr = sock.recvfrom(4096)
+            nack = sequence.nack()
+            if nack:
+                sock.sendto(nack, (SERVER_IP, SEND_PORT))
+
+            data, addr = sock.recvfrom(65536)
             if not data:
                 continue
 
-            tag_byte = data[0]
-            payload  = data[1:]
+            if data[0] == SEQUENCE_MAGIC and len(data) >= 5:
+                if not sequence.accept(int.from_bytes(data[1:5], "little")):
+                    continue
+                data = data[5:]
 
-            # Tag filter
-            if SHOW_TYPES and tag_byte not in SHOW_TYPES:
-                continue
+            for tag_byte, payload in decode_datagram(data):
+                if tag_byte == FRAGMENT_TAG:
+                    event = reassemble(payload)
+                    if event is None:
+                        continue
+                    tag_byte, payload = event
 
-            # Deduplication: block if the exact stripped text was shown
-            # in the last DEDUP_WINDOW seconds.
-            if is_duplicate(payload):
-                continue
+                event = None
+                if tag_byte & STRUCTURED_FLAG and (tag_byte & ~STRUCTURED_FLAG) in TAG_MAP:
+                    tag_byte &= ~STRUCTURED_FLAG
+                    event = decode_event(payload)
+                    payload = event_text(event)
+
+                # Tag filter
+                if SHOW_TYPES and tag_byte not in SHOW_TYPES:
+                    continue
+
+                # Deduplication: block if the exact stripped text was shown
+                # in the last DEDUP_WINDOW seconds.
+                if is_duplicate(payload):
+                    continue
 
-            timestamp     = f"{ANSI_GREY}[{datetime.datetime.now().strftime('%H:%M:%S')}]{ANSI_RESET}"
-            tag_label     = TAG_MAP.get(tag_byte, f"[UNK:0x{tag_byte:02X}]")
-            formatted_msg = parse_goldsrc_colors(payload)
+                when = datetime.datetime.now()
+                if event and event["time"] is not None:
+                    when = datetime.datetime.fromtimestamp(event["time"] / 1e6)
+                timestamp     = f"{ANSI_GREY}[{when.strftime('%H:%M:%S')}]{ANSI_RESET}"
+                tag_label     = TAG_MAP.get(tag_byte, f"[UNK:0x{tag_byte:02X}]")
+                formatted_msg = parse_goldsrc_colors(payload)
+                if event:
+                    details = [f"#{event['seq']}"]
+                    if event["client"] is not None:
+                        details.append(f"client={event['client']}")
+                    if event["dest"] is not None:
+                        details.append(f"dest={event['dest']}")
+                    tag_label += f" {ANSI_GREY}{' '.join(details)}{ANSI_RESET}"
 
-            print(f"{timestamp} {tag_label} {formatted_msg}")
+                print(f"{timestamp} {tag_label} {formatted_msg}")
 
         except socket.timeout:
             continue
@@ -177,6 +399,28 @@ def listener_thread(stop_event: threading.Event):
     sock.close()
     print("[INFO] Listener stopped.")
 
+def send_request(sock: socket.socket, request_id: int, command: str):
+    sock.sendto(bytes([REQUEST_MAGIC]) + request_id.to_bytes(4, "little") + command.encode('utf-8'),
+                (SERVER_IP, SEND_PORT))
+    deadline = time.monotonic() + REPLY_TIMEOUT
+    while time.monotonic() < deadline:
+        sock.settimeout(max(deadline - time.monotonic(), 0.01))
+        try:
+            data, _ = sock.recvfrom(65536)
+        except socket.timeout:
+            break
+        if len(data) < REPLY_HEADER or data[0] != REQUEST_MAGIC or \
+                int.from_bytes(data[1:5], "little") != request_id:
+            continue   # a late reply to an earlier request
+        wait_us = int.from_bytes(data[6:10], "little")
+        run_us = int.from_bytes(data[10:14], "little")
+        truncated = " truncated" if data[5] & REPLY_TRUNCATED else ""
+        print(f"{ANSI_GREY}[reply #{request_id}] queued {wait_us / 1000:.1f}ms, "
+              f"output over {run_us / 1000:.1f}ms{truncated}{ANSI_RESET}")
+        print(parse_goldsrc_colors(data[REPLY_HEADER:]), end="")
+        return
+    print(f"[WARN] No reply to #{request_id} within {REPLY_TIMEOUT:.0f}s")
+
 # ==============================================================================
 # MAIN
 # ==============================================================================
@@ -196,6 +440,7 @@ def main():
     t.start()
 
     send_sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    request_id = 0
 
     try:
         while True:
@@ -205,6 +450,10 @@ def main():
             if not cmd.strip():
                 continue
             try:
+                if cmd.startswith('?'):
+                    request_id += 1
+                    send_request(send_sock, request_id, cmd[1:].strip())
+                    continue
                 send_sock.sendto(cmd.encode('utf-8'), (SERVER_IP, SEND_PORT))
             except Exception as e:
                 print(f"[ERROR] Send failed: {e}")